@@ -8,8 +8,8 @@
 #include <algorithm>
 #include <queue>
 
-BTB::BTB() {
-    for(int i = 1; i<=CFID_SIZE;i++)
+BTB::BTB(int size) : size(size), prediction_table(size + 1) {
+    for(int i = 1; i<=size;i++)
     {
         free_CFID_list.push_back(i);
     }
@@ -56,7 +56,7 @@ bool BTB::update_prediction(int cfid, int pc, int prediction) {
 }
 
 bool BTB::add_cfid(int cfid) {
-    if(CF_instn_order.size() <=CFID_SIZE) {
+    if((int) CF_instn_order.size() <=size) {
         CF_instn_order.push_back(cfid);
         last_control_flow_instr = cfid;     // this will act most recent instruction
         return true;
@@ -68,7 +68,7 @@ bool BTB::add_cfid(int cfid) {
 int BTB::get_last_prediction(int pc) {
 
     //@discuss can there be conflicts????????????????????
-    for(int i = 1; i<=CFID_SIZE;i++)
+    for(int i = 1; i<=size;i++)
     {
         if(prediction_table[i].pc == pc)
             return prediction_table[i].last_prediction;
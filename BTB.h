@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <deque>
+#include <vector>
 #include "helper.h"
 using namespace std;
 
@@ -29,11 +30,12 @@ public:
     deque<int> CF_instn_order;
     deque<int> free_CFID_list;
     int last_control_flow_instr;
+    int size;                               // Number of CFIDs, 1..size
 
-    BTS prediction_table[7]; // Max 8 entries.
+    vector<BTS> prediction_table;           // Indexed by CFID
 
     // methods
-    BTB();
+    BTB(int size = CFID_SIZE);
     int get_next_free_CFID();
     bool add_CFID_to_free_list(int cfid);
     bool add_cfid(int cfid);                // This shud be called immediately after get_next_free_CFID()
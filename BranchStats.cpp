@@ -0,0 +1,136 @@
+/*
+ * BranchStats.cpp
+ *
+ *  Per branch-PC statistics for BZ/BNZ/JUMP/JAL.
+ */
+
+#include <string.h>
+#include "BranchStats.h"
+
+BranchRecord::BranchRecord() {
+    opcode[0] = '\0';
+    executions = 0;
+    taken = 0;
+    mispredicts = 0;
+    btb_lookups = 0;
+    btb_correct = 0;
+    squashed_rob = 0;
+    squashed_iq = 0;
+    squashed_lsq = 0;
+    squashed_frontend = 0;
+    refill_cycles = 0;
+}
+
+BranchStats::BranchStats() {
+    pending_refill_pc = GARBAGE;
+    pending_refill_clock = 0;
+    frozen = false;
+}
+
+// Start of the region of interest: every record is dropped.
+void BranchStats::reset() {
+    records.clear();
+    pending_refill_pc = GARBAGE;
+    frozen = false;
+}
+
+// End of the region of interest: later branches are no longer recorded.
+void BranchStats::freeze() {
+    frozen = true;
+}
+
+/*
+ * Called once per executed branch. btb_prediction is the value returned by
+ * BTB::get_last_prediction before the outcome is recorded (GARBAGE on miss).
+ */
+void BranchStats::record_resolution(int pc, const char *opcode, int taken,
+                                    int btb_prediction) {
+    if (frozen)
+        return;
+    BranchRecord &rec = records[pc];
+    strcpy(rec.opcode, opcode);
+    rec.executions++;
+    if (taken)
+        rec.taken++;
+    if (btb_prediction != GARBAGE) {
+        rec.btb_lookups++;
+        if (btb_prediction == taken)
+            rec.btb_correct++;
+    }
+}
+
+void BranchStats::record_flush(int pc, int clock, int rob, int iq, int lsq,
+                               int frontend) {
+    if (frozen)
+        return;
+    // A flush before the pipeline refilled ends the previous refill window.
+    note_dispatch(clock);
+
+    BranchRecord &rec = records[pc];
+    rec.mispredicts++;
+    rec.squashed_rob += rob;
+    rec.squashed_iq += iq;
+    rec.squashed_lsq += lsq;
+    rec.squashed_frontend += frontend;
+
+    pending_refill_pc = pc;
+    pending_refill_clock = clock;
+}
+
+// Called whenever an instruction is added to the ROB.
+void BranchStats::note_dispatch(int clock) {
+    if (frozen || pending_refill_pc == GARBAGE)
+        return;
+    records[pending_refill_pc].refill_cycles += clock - pending_refill_clock;
+    pending_refill_pc = GARBAGE;
+}
+
+void BranchStats::print() {
+    long total_exec = 0, total_mispredicts = 0, total_refill = 0;
+
+    printf("\n\n============== BRANCH STATISTICS =============\n\n");
+    printf("%-8s %-6s %-8s %-8s %-8s %-8s %-6s %-6s %-6s %-6s %-8s\n", "pc",
+           "opcode", "exec", "taken%", "mispred", "btb-acc%", "sqROB",
+           "sqIQ", "sqLSQ", "sqFE", "refill");
+
+    for (map<int, BranchRecord>::iterator itr = records.begin();
+         itr != records.end(); itr++) {
+        BranchRecord &rec = itr->second;
+        double taken_rate = rec.executions ?
+                            100.0 * rec.taken / rec.executions : 0.0;
+        double btb_accuracy = rec.btb_lookups ?
+                              100.0 * rec.btb_correct / rec.btb_lookups : 0.0;
+        printf("%-8d %-6s %-8ld %-8.1f %-8ld %-8.1f %-6ld %-6ld %-6ld %-6ld %-8ld\n",
+               itr->first, rec.opcode, rec.executions, taken_rate,
+               rec.mispredicts, btb_accuracy, rec.squashed_rob,
+               rec.squashed_iq, rec.squashed_lsq, rec.squashed_frontend,
+               rec.refill_cycles);
+        total_exec += rec.executions;
+        total_mispredicts += rec.mispredicts;
+        total_refill += rec.refill_cycles;
+    }
+
+    printf("\nBranches executed = %ld, Flushes = %ld, Refill cycles = %ld\n",
+           total_exec, total_mispredicts, total_refill);
+}
+
+bool BranchStats::write_csv(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "pc,opcode,executions,taken,mispredicts,btb_lookups,"
+                "btb_correct,squashed_rob,squashed_iq,squashed_lsq,"
+                "squashed_frontend,refill_cycles\n");
+    for (map<int, BranchRecord>::iterator itr = records.begin();
+         itr != records.end(); itr++) {
+        BranchRecord &rec = itr->second;
+        fprintf(fp, "%d,%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n",
+                itr->first, rec.opcode, rec.executions, rec.taken,
+                rec.mispredicts, rec.btb_lookups, rec.btb_correct,
+                rec.squashed_rob, rec.squashed_iq, rec.squashed_lsq,
+                rec.squashed_frontend, rec.refill_cycles);
+    }
+    fclose(fp);
+    return true;
+}
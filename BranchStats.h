@@ -0,0 +1,51 @@
+/*
+ * BranchStats.h
+ *
+ *  Per branch-PC statistics for BZ/BNZ/JUMP/JAL: outcome, BTB accuracy
+ *  and the cost of every flush issued from intFU.
+ */
+
+#ifndef BRANCHSTATS_H_
+#define BRANCHSTATS_H_
+
+#include <map>
+#include <stdio.h>
+#include "helper.h"
+using namespace std;
+
+struct BranchRecord {
+    char opcode[128];
+    long executions;
+    long taken;
+    long mispredicts;       // Fetch falls through, so every redirect flushes
+    long btb_lookups;       // Executions that found a BTB prediction
+    long btb_correct;
+    long squashed_rob;
+    long squashed_iq;
+    long squashed_lsq;
+    long squashed_frontend; // D/RF and QUEUE latches cleared by the flush
+    long refill_cycles;     // Flush until the next instruction reaches the ROB
+
+    BranchRecord();
+};
+
+class BranchStats {
+public:
+    map<int, BranchRecord> records;
+    int pending_refill_pc;
+    int pending_refill_clock;
+    bool frozen;            // Region of interest closed, updates ignored
+
+    BranchStats();
+    void reset();
+    void freeze();
+    void record_resolution(int pc, const char *opcode, int taken,
+                           int btb_prediction);
+    void record_flush(int pc, int clock, int rob, int iq, int lsq,
+                      int frontend);
+    void note_dispatch(int clock);
+    void print();
+    bool write_csv(const char *filename);
+};
+
+#endif /* BRANCHSTATS_H_ */
@@ -0,0 +1,291 @@
+/*
+ * DataMemory.cpp
+ *
+ *  Sparse data memory with lazily allocated pages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "DataMemory.h"
+
+DataMemory::DataMemory(long limit, int alignment) {
+    this->limit = limit;
+    this->alignment = alignment > 0 ? alignment : 1;
+    faults = 0;
+    fault_pc = GARBAGE;
+    fault_address = GARBAGE;
+    last_page_number = -1;
+    last_page = NULL;
+}
+
+DataMemory::~DataMemory() {
+    for (unordered_map<int, int *>::iterator itr = pages.begin();
+         itr != pages.end(); ++itr)
+        free(itr->second);
+}
+
+/*
+ * Returns the page holding address. Missing pages are allocated only when
+ * allocate is set, otherwise NULL is returned for them.
+ */
+int *DataMemory::page(int address, bool allocate) {
+    int number = address / PAGE_WORDS;
+    if (number == last_page_number)
+        return last_page;
+
+    int *found = NULL;
+    unordered_map<int, int *>::iterator itr = pages.find(number);
+    if (itr != pages.end()) {
+        found = itr->second;
+    } else if (allocate) {
+        found = (int *) calloc(PAGE_WORDS, sizeof(int));
+        pages[number] = found;
+    } else {
+        return NULL;
+    }
+    last_page_number = number;
+    last_page = found;
+    return found;
+}
+
+/*
+ * Reports an out of range or misaligned access. Only the first fault is
+ * printed, the rest are counted.
+ */
+bool DataMemory::check(int pc, int address, const char *access) {
+    const char *reason = NULL;
+    if (address < 0 || address >= limit)
+        reason = "out of range";
+    else if (address % alignment != 0)
+        reason = "misaligned";
+    if (!reason)
+        return true;
+
+    if (faults == 0) {
+        fault_pc = pc;
+        fault_address = address;
+        printf("APEX_CPU : Memory fault at pc(%d): %s of MEM[%d] is %s\n", pc,
+               access, address, reason);
+    }
+    faults++;
+    return false;
+}
+
+// Checks an address like read/write do, without reporting a fault.
+bool DataMemory::can_access(int address) {
+    return address >= 0 && address < limit && address % alignment == 0;
+}
+
+bool DataMemory::read(int pc, int address, int *value) {
+    if (!check(pc, address, "load")) {
+        *value = 0;
+        return false;
+    }
+    int *p = page(address, false);
+    *value = p ? p[address % PAGE_WORDS] : 0;
+    return true;
+}
+
+bool DataMemory::write(int pc, int address, int value) {
+    if (!check(pc, address, "store"))
+        return false;
+    page(address, true)[address % PAGE_WORDS] = value;
+    return true;
+}
+
+// Reads a word without fault checks or page allocation, for dumps.
+int DataMemory::peek(int address) {
+    if (address < 0)
+        return 0;
+    int *p = page(address, false);
+    return p ? p[address % PAGE_WORDS] : 0;
+}
+
+/*
+ * Copies a binary file of 32-bit words into memory starting at word
+ * address base. All-zero pages of the file are skipped so they stay
+ * unallocated. Returns the number of words loaded, -1 on error.
+ */
+long DataMemory::preload(const char *filename, int base) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    long words = st.st_size / sizeof(int);
+    if (words == 0) {
+        close(fd);
+        return 0;
+    }
+    if (base < 0 || base + words > limit) {
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+
+    const int *src = (const int *) data;
+    long i = 0;
+    while (i < words) {
+        int address = base + i;
+        long chunk = PAGE_WORDS - address % PAGE_WORDS;
+        if (chunk > words - i)
+            chunk = words - i;
+
+        bool zero = true;
+        for (long j = 0; j < chunk && zero; j++)
+            zero = src[i + j] == 0;
+        if (!zero || page(address, false))
+            memcpy(page(address, true) + address % PAGE_WORDS, src + i,
+                   chunk * sizeof(int));
+        i += chunk;
+    }
+    munmap(data, st.st_size);
+    return words;
+}
+
+int DataMemory::page_count() {
+    return (int) pages.size();
+}
+
+// Allocated page numbers in address order.
+vector<int> DataMemory::page_numbers() {
+    vector<int> numbers;
+    for (unordered_map<int, int *>::iterator itr = pages.begin();
+         itr != pages.end(); ++itr)
+        numbers.push_back(itr->first);
+    sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+/*
+ * Writes memory from address 0 to the end of the highest allocated page
+ * as raw 32-bit words, the same format preload reads. Untouched pages are
+ * seeked over rather than written. A page at or above MEM_DUMP_MAX_WORDS
+ * is not written and fails the dump, so a stray high STORE can neither
+ * turn it into a multi-GB file nor go missing from it unnoticed.
+ */
+bool DataMemory::dump(const char *filename) {
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
+        return false;
+
+    vector<int> numbers = page_numbers();
+    bool ok = true;
+    int next = 0;
+    int omitted = 0;
+    for (int i = 0; i < (int) numbers.size() && ok; i++) {
+        if ((long) numbers[i] * PAGE_WORDS >= MEM_DUMP_MAX_WORDS) {
+            omitted++;
+            continue;
+        }
+        if (numbers[i] > next)
+            ok = fseek(fp, (long) (numbers[i] - next) * PAGE_WORDS
+                           * sizeof(int), SEEK_CUR) == 0;
+        ok = ok && fwrite(pages[numbers[i]], sizeof(int), PAGE_WORDS, fp)
+                   == PAGE_WORDS;
+        next = numbers[i] + 1;
+    }
+    if (omitted)
+        fprintf(stderr, "DataMemory : %d pages at or above word %ld left "
+                "out of %s, use --state-dump for the whole memory\n",
+                omitted, (long) MEM_DUMP_MAX_WORDS, filename);
+    return fclose(fp) == 0 && ok && !omitted;
+}
+
+/*
+ * Writes the non-zero words as runs of (uint32 address, uint32 count,
+ * count words), ended by a run with count 0.
+ */
+void DataMemory::write_runs(FILE *fp) {
+    vector<int> numbers = page_numbers();
+    for (int i = 0; i < (int) numbers.size(); i++) {
+        int *p = pages[numbers[i]];
+        int j = 0;
+        while (j < PAGE_WORDS) {
+            if (p[j] == 0) {
+                j++;
+                continue;
+            }
+            int start = j;
+            while (j < PAGE_WORDS && p[j] != 0)
+                j++;
+            unsigned int run[2] = {
+                    (unsigned int) (numbers[i] * PAGE_WORDS + start),
+                    (unsigned int) (j - start)};
+            fwrite(run, sizeof(run), 1, fp);
+            fwrite(p + start, sizeof(int), j - start, fp);
+        }
+    }
+    unsigned int end[2] = {0, 0};
+    fwrite(end, sizeof(end), 1, fp);
+}
+
+/*
+ * Compares memory against a raw image of 32-bit words. Words past the
+ * end of the image are expected to be zero. Prints the first max_report
+ * mismatches and returns the total, -1 if the image cannot be read.
+ */
+long DataMemory::diff(const char *filename, int max_report) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    long words = st.st_size / sizeof(int);
+    const int *expected = NULL;
+    if (words > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        expected = (const int *) data;
+    }
+    close(fd);
+
+    long mismatches = 0;
+    for (long address = 0; address < words; address++) {
+        int actual = peek(address);
+        if (actual != expected[address]) {
+            if (mismatches < max_report)
+                printf("|\tMEM[%ld]\t|\tExpected = %d\t|\tActual = %d\t|\n",
+                       address, expected[address], actual);
+            mismatches++;
+        }
+    }
+
+    // Anything stored beyond the image must still be zero
+    vector<int> numbers = page_numbers();
+    for (int i = 0; i < (int) numbers.size(); i++) {
+        int *p = pages[numbers[i]];
+        for (int j = 0; j < PAGE_WORDS; j++) {
+            long address = (long) numbers[i] * PAGE_WORDS + j;
+            if (address < words || p[j] == 0)
+                continue;
+            if (mismatches < max_report)
+                printf("|\tMEM[%ld]\t|\tExpected = 0\t|\tActual = %d\t|\n",
+                       address, p[j]);
+            mismatches++;
+        }
+    }
+
+    if (expected)
+        munmap((void *) expected, st.st_size);
+    return mismatches;
+}
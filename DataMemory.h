@@ -0,0 +1,51 @@
+/*
+ * DataMemory.h
+ *
+ *  Sparse data memory over the whole non-negative word address range.
+ *  Pages of PAGE_WORDS words (4 KB) are allocated, zeroed, on first
+ *  write, so a run only pays for the memory it touches.
+ */
+
+#ifndef DATAMEMORY_H_
+#define DATAMEMORY_H_
+
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+#include "helper.h"
+using namespace std;
+
+#define PAGE_WORDS 1024
+#define MEM_DUMP_MAX_WORDS (16L << 20)  // 64 MB cap on --mem-dump files
+
+class DataMemory {
+public:
+    unordered_map<int, int *> pages;    // Page number -> page
+    long limit;         // Addresses at or above this fault
+    int alignment;      // Addresses must be a multiple of this, 1 = any
+    long faults;
+    int fault_pc;       // First fault, GARBAGE if none
+    int fault_address;
+
+    DataMemory(long limit, int alignment);
+    ~DataMemory();
+    bool read(int pc, int address, int *value);
+    bool write(int pc, int address, int value);
+    bool can_access(int address);       // Would not fault
+    int peek(int address);
+    long preload(const char *filename, int base);
+    bool dump(const char *filename);
+    void write_runs(FILE *fp);
+    long diff(const char *filename, int max_report);
+    int page_count();
+    vector<int> page_numbers();
+
+private:
+    int last_page_number;
+    int *last_page;
+
+    bool check(int pc, int address, const char *access);
+    int *page(int address, bool allocate);
+};
+
+#endif /* DATAMEMORY_H_ */
@@ -0,0 +1,76 @@
+/*
+ * FreeList.cpp
+ *
+ *  Reference counted free list of the unified register file.
+ */
+
+#include "FreeList.h"
+
+FreeList::FreeList(int size)
+        : refs(size, 0), has_constant(size, 0), constant(size, 0), size(size) {
+    for (int i = 0; i < size; i++)
+        free_regs.push_back(i);
+}
+
+int FreeList::allocate() {
+    if (free_regs.empty())
+        return -1;
+    int reg = free_regs.front();
+    free_regs.pop_front();
+    refs[reg] = 1;
+    has_constant[reg] = 0;
+    return reg;
+}
+
+void FreeList::share(int reg) {
+    if (reg >= 0 && reg < size)
+        refs[reg]++;
+}
+
+bool FreeList::release(int reg) {
+    if (reg < 0 || reg >= size || refs[reg] <= 0)
+        return false;
+    if (--refs[reg] > 0)
+        return false;
+    free_regs.push_back(reg);
+    return true;
+}
+
+/*
+ * Replaces the reference counts with live_refs, freeing every register
+ * left without one. Returns the number of registers that became free.
+ */
+int FreeList::rebuild(const vector<int> &live_refs) {
+    int freed = 0;
+    deque<int> kept;
+    for (int i = 0; i < (int) free_regs.size(); i++) {
+        if (!live_refs[free_regs[i]])
+            kept.push_back(free_regs[i]);
+    }
+    free_regs = kept;
+    for (int reg = 0; reg < size; reg++) {
+        if (!live_refs[reg] && refs[reg] > 0) {
+            free_regs.push_back(reg);
+            freed++;
+        }
+        refs[reg] = live_refs[reg];
+    }
+    return freed;
+}
+
+int FreeList::count() {
+    return (int) free_regs.size();
+}
+
+int FreeList::find_constant(int value) {
+    for (int reg = 0; reg < size; reg++) {
+        if (refs[reg] > 0 && has_constant[reg] && constant[reg] == value)
+            return reg;
+    }
+    return -1;
+}
+
+void FreeList::set_constant(int reg, int value) {
+    has_constant[reg] = 1;
+    constant[reg] = value;
+}
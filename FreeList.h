@@ -0,0 +1,39 @@
+/*
+ * FreeList.h
+ *
+ *  Free list of the unified register file. The renamer takes destination
+ *  registers from the front, commit (or early release) returns the
+ *  mapping an instruction replaced, and a branch flush rebuilds the list
+ *  from the registers still referenced.
+ *
+ *  With move elimination several mappings can share a register, so each
+ *  register counts its references and is only free once none is left.
+ */
+
+#ifndef FREELIST_H_
+#define FREELIST_H_
+
+#include <deque>
+#include <vector>
+#include "helper.h"
+using namespace std;
+
+class FreeList {
+public:
+    deque<int> free_regs;               // Oldest freed register first
+    vector<int> refs;                   // Mappings per URF register, 0 if free
+    vector<int> has_constant;           // Written at rename with 'constant'
+    vector<int> constant;
+    int size;
+
+    FreeList(int size = URF_SIZE);
+    int allocate();                     // -1 if every register is in use
+    void share(int reg);
+    bool release(int reg);              // true if reg became free
+    int rebuild(const vector<int> &live_refs);
+    int count();
+    int find_constant(int value);       // -1 if no live register holds it
+    void set_constant(int reg, int value);
+};
+
+#endif /* FREELIST_H_ */
@@ -0,0 +1,117 @@
+/*
+ * GoldenModel.cpp
+ *
+ *  ISA level reference interpreter, one instruction per call to step().
+ */
+
+#include <string.h>
+#include "GoldenModel.h"
+
+GoldenModel::GoldenModel(APEX_Instruction *code_memory, int code_memory_size,
+                         DataMemory *data_memory) {
+    this->code_memory = code_memory;
+    this->code_memory_size = code_memory_size;
+    this->data_memory = data_memory;
+    memset(regs, 0, sizeof(regs));
+    zero_flag = 0;
+    pc = 4000;
+    halted = 0;
+    committed = 0;
+}
+
+GoldenModel::~GoldenModel() {
+    delete data_memory;
+}
+
+/*
+ * Executes the instruction at pc. Returns false once the program has
+ * halted or run off the end of code memory.
+ */
+bool GoldenModel::step(GoldenResult *result) {
+    int index = get_code_index(pc);
+    if (halted || index < 0 || index >= code_memory_size)
+        return false;
+
+    APEX_Instruction *ins = &code_memory[index];
+    int next_pc = pc + 4;
+    int value = 0;
+
+    result->pc = pc;
+    result->op = ins->op;
+    result->rd = -1;
+    result->sets_flag = 0;
+    result->mem_address = -1;
+
+    switch (ins->op) {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_AND:
+    case OP_OR:
+    case OP_EXOR:
+    case OP_ADDL:
+    case OP_SUBL: {
+        int a = regs[ins->rs1];
+        int b = (ins->op == OP_ADDL || ins->op == OP_SUBL) ? ins->imm
+                                                           : regs[ins->rs2];
+        if (ins->op == OP_ADD || ins->op == OP_ADDL)
+            value = a + b;
+        else if (ins->op == OP_SUB || ins->op == OP_SUBL)
+            value = a - b;
+        else if (ins->op == OP_MUL)
+            value = a * b;
+        else if (ins->op == OP_AND)
+            value = a & b;
+        else if (ins->op == OP_OR)
+            value = a | b;
+        else
+            value = a ^ b;
+        result->rd = ins->rd;
+        result->sets_flag = 1;
+        zero_flag = value == 0;
+        break;
+    }
+    case OP_MOVC:
+        value = ins->imm;
+        result->rd = ins->rd;
+        break;
+    case OP_LOAD:
+        result->mem_address = regs[ins->rs1] + ins->imm;
+        data_memory->read(pc, result->mem_address, &value);
+        result->rd = ins->rd;
+        break;
+    case OP_STORE:
+        result->mem_address = regs[ins->rs2] + ins->imm;
+        result->store_value = regs[ins->rs1];
+        data_memory->write(pc, result->mem_address, result->store_value);
+        break;
+    case OP_BZ:
+        if (zero_flag)
+            next_pc = pc + ins->imm;
+        break;
+    case OP_BNZ:
+        if (!zero_flag)
+            next_pc = pc + ins->imm;
+        break;
+    case OP_JUMP:
+        next_pc = regs[ins->rs1] + ins->imm;
+        break;
+    case OP_JAL:
+        value = pc + 4;
+        result->rd = ins->rd;
+        next_pc = regs[ins->rs1] + ins->imm;
+        break;
+    case OP_HALT:
+        halted = 1;
+        break;
+    }
+
+    if (result->rd >= 0) {
+        regs[result->rd] = value;
+        result->rd_value = value;
+    }
+    result->zero_flag = zero_flag;
+    pc = next_pc;
+    committed++;
+    return true;
+}
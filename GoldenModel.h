@@ -0,0 +1,45 @@
+/*
+ * GoldenModel.h
+ *
+ *  ISA level reference interpreter run in lock-step with the pipeline.
+ *  It executes one instruction each time the pipeline commits one and
+ *  reports what that instruction must have done, so the commit points
+ *  can check the architectural state against it.
+ */
+
+#ifndef GOLDENMODEL_H_
+#define GOLDENMODEL_H_
+
+#include "cpu.h"
+#include "DataMemory.h"
+
+/* Architectural effect of one instruction */
+struct GoldenResult {
+    int pc;
+    int op;
+    int rd;             // Destination register, -1 if none
+    int rd_value;
+    int sets_flag;      // Arithmetic instruction, updates the zero flag
+    int zero_flag;
+    int mem_address;    // LOAD/STORE address, -1 if none
+    int store_value;
+};
+
+class GoldenModel {
+public:
+    APEX_Instruction *code_memory;
+    int code_memory_size;
+    DataMemory *data_memory;
+    int regs[NUM_ARCH_REGISTERS];
+    int zero_flag;
+    int pc;
+    int halted;
+    long committed;
+
+    GoldenModel(APEX_Instruction *code_memory, int code_memory_size,
+                DataMemory *data_memory);
+    ~GoldenModel();
+    bool step(GoldenResult *result);
+};
+
+#endif /* GOLDENMODEL_H_ */
@@ -0,0 +1,175 @@
+/*
+ * InstrWindow.cpp
+ *
+ *  Shadow of the in-flight instructions in ROB (program) order.
+ */
+
+#include <string.h>
+#include "InstrWindow.h"
+
+DynInstr::DynInstr() {
+    seq = 0;
+    pc = GARBAGE;
+    opcode[0] = '\0';
+    u_rd = -1;
+    prev_u_rd = -1;
+    prev_released = 0;
+    fused_cfid = 0;
+    src1 = -1;
+    src2 = -1;
+    src1_pending = 0;
+    src2_pending = 0;
+    is_mem = 0;
+    issued = 0;
+    mem_address = -1;
+    predicted = 0;
+    predicted_value = 0;
+    early = 0;
+    early_value = 0;
+    wait_seq = 0;
+    held = 0;
+    fetch_clock = -1;
+    rename_clock = -1;
+    dispatch_clock = -1;
+    ready_clock = -1;
+    issue_clock = -1;
+    complete_clock = -1;
+    retire_clock = -1;
+    chain_depth = 1;
+    chain_head_pc = GARBAGE;
+    chain_start_clock = -1;
+}
+
+InstrWindow::InstrWindow() {
+}
+
+/*
+ * Appends a newly dispatched instruction. The caller fills in pc, opcode,
+ * registers and the fetch/rename/dispatch clocks; the dependence chain and
+ * the ready clock are derived here.
+ */
+void InstrWindow::dispatch(DynInstr instr) {
+    instr.chain_depth = 1;
+    instr.chain_head_pc = instr.pc;
+    instr.chain_start_clock = instr.dispatch_clock;
+
+    int srcs[2] = {instr.src1, instr.src2};
+    for (int i = 0; i < 2; i++) {
+        int reg = srcs[i];
+        if (reg < 0 || reg >= (int) last_writer.size())
+            continue;
+        DynInstr &producer = last_writer[reg];
+        if (producer.pc != GARBAGE
+            && producer.chain_depth + 1 > instr.chain_depth) {
+            instr.chain_depth = producer.chain_depth + 1;
+            instr.chain_head_pc = producer.chain_head_pc;
+            instr.chain_start_clock = producer.chain_start_clock;
+        }
+    }
+
+    if (!instr.src1_pending && !instr.src2_pending)
+        instr.ready_clock = instr.dispatch_clock;
+    if (instr.issued)
+        instr.issue_clock = instr.dispatch_clock;
+
+    if (instr.u_rd >= 0) {
+        if (instr.u_rd >= (int) last_writer.size())
+            last_writer.resize(instr.u_rd + 1);
+        last_writer[instr.u_rd] = instr;
+    }
+    entries.push_back(instr);
+}
+
+// Returns the window index of the instruction, -1 if it is not in flight.
+int InstrWindow::find(int dispatch_clock, int pc) {
+    for (int i = 0; i < (int) entries.size(); i++) {
+        if (entries[i].dispatch_clock == dispatch_clock && entries[i].pc == pc)
+            return i;
+    }
+    return -1;
+}
+
+DynInstr *InstrWindow::get(int dispatch_clock, int pc) {
+    int index = find(dispatch_clock, pc);
+    if (index == -1)
+        return NULL;
+    return &entries[index];
+}
+
+// Oldest LOAD/STORE still holding an LSQ entry, i.e. the LSQ head.
+DynInstr *InstrWindow::oldest_mem() {
+    for (int i = 0; i < (int) entries.size(); i++) {
+        if (entries[i].is_mem)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+void InstrWindow::mark_issued(int dispatch_clock, int pc, int clock) {
+    DynInstr *instr = get(dispatch_clock, pc);
+    if (instr) {
+        instr->issued = 1;
+        instr->issue_clock = clock;
+    }
+}
+
+/*
+ * Marks the instruction complete and wakes up in-flight consumers of its
+ * destination register, mirroring updateIssueQueueEntries.
+ */
+void InstrWindow::complete(DynInstr *instr, int clock) {
+    if (!instr)
+        return;
+    instr->complete_clock = clock;
+    if (instr->u_rd < 0)
+        return;
+
+    for (int i = 0; i < (int) entries.size(); i++) {
+        DynInstr &consumer = entries[i];
+        if (consumer.ready_clock != -1)
+            continue;
+        if (consumer.src1_pending && consumer.src1 == instr->u_rd)
+            consumer.src1_pending = 0;
+        if (consumer.src2_pending && consumer.src2 == instr->u_rd)
+            consumer.src2_pending = 0;
+        if (!consumer.src1_pending && !consumer.src2_pending)
+            consumer.ready_clock = clock;
+    }
+}
+
+// Oldest instruction leaves the window, mirrors retire_instruction_from_ROB.
+void InstrWindow::retire() {
+    if (!entries.empty())
+        entries.pop_front();
+}
+
+/*
+ * Drops every instruction younger than 'index', mirrors flush_ROB_entries.
+ * Returns the number of ROB entries squashed and reports how many of them
+ * were still waiting in the IQ and how many held an LSQ entry.
+ */
+int InstrWindow::squash_younger(int index, int *iq_count, int *lsq_count) {
+    int rob_count = 0;
+    *iq_count = 0;
+    *lsq_count = 0;
+    squashed.clear();
+
+    if (index < 0)
+        return 0;
+
+    while ((int) entries.size() > index + 1) {
+        DynInstr &instr = entries.back();
+        if (!instr.issued)
+            (*iq_count)++;
+        if (instr.is_mem)
+            (*lsq_count)++;
+        rob_count++;
+        squashed.push_back(instr.seq);
+        entries.pop_back();
+    }
+    return rob_count;
+}
+
+int InstrWindow::size() {
+    return (int) entries.size();
+}
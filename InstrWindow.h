@@ -0,0 +1,74 @@
+/*
+ * InstrWindow.h
+ *
+ *  Shadow of the in-flight instructions in ROB (program) order.
+ *  Entries are identified by their dispatch clock, which is what
+ *  IQEntry::clock carries through the IQ and function units.
+ */
+
+#ifndef INSTRWINDOW_H_
+#define INSTRWINDOW_H_
+
+#include <deque>
+#include <vector>
+#include "helper.h"
+using namespace std;
+
+struct DynInstr {
+    int seq;            // Kanata id
+    int pc;
+    char opcode[128];
+    int u_rd;           // Destination URF register, -1 if none
+    int prev_u_rd;      // Mapping u_rd replaced, -1 if none
+    int prev_released;  // prev_u_rd went back to the free list early
+    int fused_cfid;     // CFID of a BZ/BNZ fused into it, 0 if none
+    int src1;           // Source URF registers, -1 if not read
+    int src2;
+    int src1_pending;   // Source not produced yet at dispatch
+    int src2_pending;
+    int is_mem;         // Holds an LSQ entry
+    int issued;         // Left the IQ (or never needed it)
+    int mem_address;    // LOAD/STORE address once accessed, else -1
+    int predicted;      // LOAD wrote predicted_value to u_rd at dispatch
+    int predicted_value;
+    int early;          // LOAD read memory ahead of the LSQ head
+    int early_value;
+    int wait_seq;       // Kanata id of the STORE its store set waits for
+    int held;           // Was kept behind that STORE
+
+    /* Lifecycle timestamps, -1 until the event happens */
+    int fetch_clock;
+    int rename_clock;
+    int dispatch_clock;
+    int ready_clock;
+    int issue_clock;
+    int complete_clock;
+    int retire_clock;
+
+    /* Longest chain of true dependences ending in this instruction */
+    int chain_depth;
+    int chain_head_pc;
+    int chain_start_clock;
+
+    DynInstr();
+};
+
+class InstrWindow {
+public:
+    deque<DynInstr> entries;
+    vector<DynInstr> last_writer;       // Chain info of the last writer of each URF register
+    vector<int> squashed;               // Kanata ids dropped by the last squash_younger
+
+    InstrWindow();
+    void dispatch(DynInstr instr);
+    int find(int dispatch_clock, int pc);
+    DynInstr *get(int dispatch_clock, int pc);
+    DynInstr *oldest_mem();
+    void mark_issued(int dispatch_clock, int pc, int clock);
+    void complete(DynInstr *instr, int clock);
+    void retire();
+    int squash_younger(int index, int *iq_count, int *lsq_count);
+    int size();
+};
+
+#endif /* INSTRWINDOW_H_ */
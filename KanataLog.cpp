@@ -0,0 +1,88 @@
+/*
+ * KanataLog.cpp
+ *
+ *  Kanata 0004 pipeline log writer.
+ *
+ *  I  <id> <id> <thread>   instruction appears
+ *  L  <id> 0 <text>        label shown in the left pane
+ *  S  <id> 0 <stage>       instruction enters a stage (ends the previous one)
+ *  W  <id> <producer> 0    data dependence arrow
+ *  R  <id> <rid> <type>    instruction leaves, type 0 = retire, 1 = flush
+ *  C  <n>                  n cycles elapse
+ *
+ *  An id only produces events between its I and its R line, so callers
+ *  may report the same flush or retire twice.
+ */
+
+#include "KanataLog.h"
+
+KanataLog::KanataLog() {
+    fp = NULL;
+    last_clock = 0;
+    retired = 0;
+}
+
+KanataLog::~KanataLog() {
+    close();
+}
+
+bool KanataLog::open(const char *filename, int clock) {
+    fp = fopen(filename, "w");
+    if (!fp)
+        return false;
+    fprintf(fp, "Kanata\t0004\n");
+    fprintf(fp, "C=\t%d\n", clock);
+    last_clock = clock;
+    return true;
+}
+
+void KanataLog::close() {
+    if (fp) {
+        fclose(fp);
+        fp = NULL;
+    }
+}
+
+// Events are written in cycle order, so only ever move forward.
+void KanataLog::advance(int clock) {
+    if (clock > last_clock) {
+        fprintf(fp, "C\t%d\n", clock - last_clock);
+        last_clock = clock;
+    }
+}
+
+void KanataLog::fetch(int clock, int id, const char *label) {
+    advance(clock);
+    live.insert(id);
+    fprintf(fp, "I\t%d\t%d\t0\n", id, id);
+    fprintf(fp, "L\t%d\t0\t%s\n", id, label);
+    fprintf(fp, "S\t%d\t0\tF\n", id);
+}
+
+void KanataLog::stage(int clock, int id, const char *name) {
+    if (!live.count(id))
+        return;
+    advance(clock);
+    fprintf(fp, "S\t%d\t0\t%s\n", id, name);
+}
+
+void KanataLog::dependency(int clock, int consumer, int producer) {
+    if (!live.count(consumer) || !live.count(producer))
+        return;
+    advance(clock);
+    fprintf(fp, "W\t%d\t%d\t0\n", consumer, producer);
+}
+
+void KanataLog::retire(int clock, int id) {
+    if (!live.erase(id))
+        return;
+    advance(clock);
+    fprintf(fp, "R\t%d\t%ld\t0\n", id, retired++);
+}
+
+void KanataLog::flush(int clock, int id) {
+    if (!live.erase(id))
+        return;
+    advance(clock);
+    fprintf(fp, "R\t%d\t0\t1\n", id);
+}
@@ -0,0 +1,37 @@
+/*
+ * KanataLog.h
+ *
+ *  Writes pipeline events in the Kanata log format (version 0004) so a
+ *  run can be loaded into the Konata pipeline viewer.
+ */
+
+#ifndef KANATALOG_H_
+#define KANATALOG_H_
+
+#include <stdio.h>
+#include <set>
+#include "helper.h"
+using namespace std;
+
+class KanataLog {
+public:
+    FILE *fp;
+    int last_clock;
+    long retired;
+    set<int> live;          // Ids shown but not yet retired or flushed
+
+    KanataLog();
+    ~KanataLog();
+    bool open(const char *filename, int clock);
+    void close();
+    void fetch(int clock, int id, const char *label);
+    void stage(int clock, int id, const char *name);
+    void dependency(int clock, int consumer, int producer);
+    void retire(int clock, int id);
+    void flush(int clock, int id);
+
+private:
+    void advance(int clock);
+};
+
+#endif /* KANATALOG_H_ */
@@ -0,0 +1,112 @@
+/*
+ * LifecycleStats.cpp
+ *
+ *  Per-opcode phase latencies and longest dependence chains.
+ */
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include "LifecycleStats.h"
+
+static const char *phase_names[NUM_PHASES] = {
+        "decode", "dispatch", "operands", "select", "execute", "commit"
+};
+
+PhaseRecord::PhaseRecord() {
+    count = 0;
+    for (int i = 0; i < NUM_PHASES; i++) {
+        cycles[i] = 0;
+        samples[i] = 0;
+    }
+}
+
+ChainRecord::ChainRecord() {
+    depth = 0;
+    head_pc = GARBAGE;
+    start_clock = -1;
+    end_clock = -1;
+}
+
+LifecycleStats::LifecycleStats() {
+    frozen = false;
+}
+
+// Start of the region of interest: every record is dropped.
+void LifecycleStats::reset() {
+    opcodes.clear();
+    chains.clear();
+    frozen = false;
+}
+
+// End of the region of interest: later retirements are no longer recorded.
+void LifecycleStats::freeze() {
+    frozen = true;
+}
+
+// Called for every retired instruction with all its timestamps filled in.
+void LifecycleStats::record(const DynInstr &instr) {
+    if (frozen)
+        return;
+    int stamps[NUM_PHASES + 1] = {
+            instr.fetch_clock, instr.rename_clock, instr.dispatch_clock,
+            instr.ready_clock, instr.issue_clock, instr.complete_clock,
+            instr.retire_clock
+    };
+
+    PhaseRecord &rec = opcodes[instr.opcode];
+    rec.count++;
+    for (int p = 0; p < NUM_PHASES; p++) {
+        if (stamps[p] < 0 || stamps[p + 1] < 0)
+            continue;
+        rec.cycles[p] += stamps[p + 1] - stamps[p];
+        rec.samples[p]++;
+    }
+
+    ChainRecord &chain = chains[instr.pc];
+    if (instr.chain_depth > chain.depth) {
+        chain.depth = instr.chain_depth;
+        chain.head_pc = instr.chain_head_pc;
+        chain.start_clock = instr.chain_start_clock;
+        chain.end_clock = instr.complete_clock;
+    }
+}
+
+static bool deeper_chain(const pair<int, ChainRecord> &a,
+                         const pair<int, ChainRecord> &b) {
+    return a.second.depth > b.second.depth;
+}
+
+void LifecycleStats::print(int max_chains) {
+    printf("\n\n============== INSTRUCTION LIFECYCLE (avg cycles) =============\n\n");
+    printf("%-8s %-8s", "opcode", "retired");
+    for (int p = 0; p < NUM_PHASES; p++)
+        printf(" %-9s", phase_names[p]);
+    printf("\n");
+
+    for (map<string, PhaseRecord>::iterator itr = opcodes.begin();
+         itr != opcodes.end(); itr++) {
+        PhaseRecord &rec = itr->second;
+        printf("%-8s %-8ld", itr->first.c_str(), rec.count);
+        for (int p = 0; p < NUM_PHASES; p++) {
+            if (rec.samples[p])
+                printf(" %-9.2f", (double) rec.cycles[p] / rec.samples[p]);
+            else
+                printf(" %-9s", "-");
+        }
+        printf("\n");
+    }
+
+    vector<pair<int, ChainRecord> > sorted(chains.begin(), chains.end());
+    sort(sorted.begin(), sorted.end(), deeper_chain);
+
+    printf("\nLongest dependence chains:\n");
+    printf("%-8s %-8s %-8s %-10s\n", "depth", "from pc", "to pc", "cycles");
+    for (int i = 0; i < (int) sorted.size() && i < max_chains; i++) {
+        ChainRecord &chain = sorted[i].second;
+        if (chain.depth < 2)
+            break;
+        printf("%-8d %-8d %-8d %-10d\n", chain.depth, chain.head_pc,
+               sorted[i].first, chain.end_clock - chain.start_clock);
+    }
+}
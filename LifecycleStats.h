@@ -0,0 +1,56 @@
+/*
+ * LifecycleStats.h
+ *
+ *  Average time retired instructions spend in each pipeline phase, per
+ *  opcode, and the longest true-dependence chains seen at retire.
+ */
+
+#ifndef LIFECYCLESTATS_H_
+#define LIFECYCLESTATS_H_
+
+#include <map>
+#include <string>
+#include "InstrWindow.h"
+using namespace std;
+
+enum {
+    PHASE_DECODE,       // fetch   -> rename
+    PHASE_DISPATCH,     // rename  -> dispatch
+    PHASE_OPERANDS,     // dispatch -> ready
+    PHASE_SELECT,       // ready   -> issue
+    PHASE_EXECUTE,      // issue   -> complete
+    PHASE_COMMIT,       // complete -> retire
+    NUM_PHASES
+};
+
+struct PhaseRecord {
+    long count;
+    long cycles[NUM_PHASES];
+    long samples[NUM_PHASES];
+
+    PhaseRecord();
+};
+
+struct ChainRecord {
+    int depth;
+    int head_pc;
+    int start_clock;
+    int end_clock;
+
+    ChainRecord();
+};
+
+class LifecycleStats {
+public:
+    map<string, PhaseRecord> opcodes;
+    map<int, ChainRecord> chains;       // Longest chain ending at each pc
+    bool frozen;                        // Region of interest closed
+
+    LifecycleStats();
+    void reset();
+    void freeze();
+    void record(const DynInstr &instr);
+    void print(int max_chains);
+};
+
+#endif /* LIFECYCLESTATS_H_ */
@@ -0,0 +1,95 @@
+/*
+ * OccupancyStats.cpp
+ *
+ *  Per-cycle occupancy samples of the IQ, ROB, LSQ, URF and CFIDs.
+ */
+
+#include <stdio.h>
+#include "OccupancyStats.h"
+
+OccupancyRecord::OccupancyRecord() {
+    name = "";
+    capacity = 0;
+    samples = 0;
+    sum = 0;
+    max = 0;
+}
+
+OccupancyStats::OccupancyStats() {
+    frozen = false;
+}
+
+// Start of the region of interest: samples are dropped, capacities kept.
+void OccupancyStats::reset() {
+    for (int i = 0; i < NUM_OCC_STRUCTURES; i++) {
+        OccupancyRecord &rec = records[i];
+        rec.histogram.assign(rec.histogram.size(), 0);
+        rec.samples = 0;
+        rec.sum = 0;
+        rec.max = 0;
+    }
+    frozen = false;
+}
+
+// End of the region of interest: later cycles are no longer sampled.
+void OccupancyStats::freeze() {
+    frozen = true;
+}
+
+void OccupancyStats::set_capacity(int structure, const char *name,
+                                  int capacity) {
+    OccupancyRecord &rec = records[structure];
+    rec.name = name;
+    rec.capacity = capacity;
+    rec.histogram.assign(capacity + 1, 0);
+}
+
+void OccupancyStats::sample(int structure, int occupancy) {
+    if (frozen)
+        return;
+    OccupancyRecord &rec = records[structure];
+    if (occupancy < 0)
+        occupancy = 0;
+    if (occupancy > rec.capacity)
+        occupancy = rec.capacity;
+
+    rec.histogram[occupancy]++;
+    rec.samples++;
+    rec.sum += occupancy;
+    if (occupancy > rec.max)
+        rec.max = occupancy;
+}
+
+double OccupancyStats::average(int structure) {
+    OccupancyRecord &rec = records[structure];
+    return rec.samples ? (double) rec.sum / rec.samples : 0.0;
+}
+
+// Fraction of sampled cycles the structure was completely full.
+double OccupancyStats::at_capacity(int structure) {
+    OccupancyRecord &rec = records[structure];
+    return rec.samples ? (double) rec.histogram[rec.capacity] / rec.samples
+                       : 0.0;
+}
+
+void OccupancyStats::print() {
+    printf("\n\n============== STRUCTURE OCCUPANCY =============\n\n");
+    printf("%-6s %-8s %-8s %-8s %-8s\n", "", "size", "avg", "max", "full%");
+    for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+        OccupancyRecord &rec = records[s];
+        printf("%-6s %-8d %-8.2f %-8d %-8.1f\n", rec.name, rec.capacity,
+               average(s), rec.max, 100.0 * at_capacity(s));
+    }
+
+    for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+        OccupancyRecord &rec = records[s];
+        if (!rec.samples)
+            continue;
+        printf("\n%s occupancy histogram (entries: %% of cycles)\n", rec.name);
+        for (int n = 0; n <= rec.capacity; n++) {
+            if (rec.histogram[n])
+                printf("    %3d : %6.1f%%\n", n,
+                       100.0 * rec.histogram[n] / rec.samples);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * OccupancyStats.h
+ *
+ *  Per-cycle occupancy samples of the IQ, ROB, LSQ, URF and CFIDs,
+ *  reported as histograms, averages and time spent at capacity.
+ */
+
+#ifndef OCCUPANCYSTATS_H_
+#define OCCUPANCYSTATS_H_
+
+#include <vector>
+#include "helper.h"
+using namespace std;
+
+enum {
+    OCC_IQ, OCC_ROB, OCC_LSQ, OCC_URF, OCC_CFID, NUM_OCC_STRUCTURES
+};
+
+struct OccupancyRecord {
+    const char *name;
+    int capacity;
+    vector<long> histogram;     // histogram[n] = cycles with n entries in use
+    long samples;
+    long sum;
+    int max;
+
+    OccupancyRecord();
+};
+
+class OccupancyStats {
+public:
+    OccupancyRecord records[NUM_OCC_STRUCTURES];
+    bool frozen;                // Region of interest closed, no sampling
+
+    OccupancyStats();
+    void reset();
+    void freeze();
+    void set_capacity(int structure, const char *name, int capacity);
+    void sample(int structure, int occupancy);
+    double average(int structure);
+    double at_capacity(int structure);
+    void print();
+};
+
+#endif /* OCCUPANCYSTATS_H_ */
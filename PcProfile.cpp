@@ -0,0 +1,172 @@
+/*
+ * PcProfile.cpp
+ *
+ *  Per-pc execution counts and the hot basic block report.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include "PcProfile.h"
+#include "cpu.h"
+
+PcRecord::PcRecord() {
+    fetched = 0;
+    issued = 0;
+    squashed = 0;
+    retired = 0;
+    head_stall_cycles = 0;
+}
+
+PcProfile::PcProfile() {
+    frozen = false;
+}
+
+void PcProfile::resize(int size) {
+    records.resize(size);
+}
+
+// Start of the region of interest: every count goes back to zero.
+void PcProfile::reset() {
+    records.assign(records.size(), PcRecord());
+    frozen = false;
+}
+
+// End of the region of interest: later updates go to the scratch record.
+void PcProfile::freeze() {
+    frozen = true;
+}
+
+/*
+ * Record of pc. A pc outside the program, or any pc once the profile is
+ * frozen, gets a scratch record that is cleared on every such call and
+ * never reported, so the update is dropped.
+ */
+PcRecord &PcProfile::at(int pc) {
+    int index = get_code_index(pc);
+    if (frozen || index < 0 || index >= (int) records.size()) {
+        ignored = PcRecord();
+        return ignored;
+    }
+    return records[index];
+}
+
+struct BlockRecord {
+    int first;              // Code indices [first, last]
+    int last;
+    long executions;        // Retirements of the first instruction
+    long retired;
+    long squashed;
+    long head_stall_cycles;
+};
+
+static bool hotter_block(const BlockRecord &a, const BlockRecord &b) {
+    return a.retired > b.retired;
+}
+
+static bool ends_block(int op) {
+    return op == OP_BZ || op == OP_BNZ || op == OP_JUMP || op == OP_JAL
+           || op == OP_HALT;
+}
+
+/*
+ * Splits the program into basic blocks: a block starts at the first
+ * instruction, at every BZ/BNZ target and after every control flow
+ * instruction (which covers JAL return points). JUMP targets are only
+ * known at run time and do not start a block.
+ */
+static vector<BlockRecord> find_blocks(const APEX_Instruction *code,
+                                       int size) {
+    vector<bool> leader(size + 1, false);
+    leader[0] = true;
+    for (int i = 0; i < size; i++) {
+        if (!ends_block(code[i].op))
+            continue;
+        leader[i + 1] = true;
+        if (code[i].op == OP_BZ || code[i].op == OP_BNZ) {
+            int target = i + code[i].imm / 4;
+            if (target >= 0 && target < size)
+                leader[target] = true;
+        }
+    }
+
+    vector<BlockRecord> blocks;
+    for (int i = 0; i < size; i++) {
+        if (leader[i] || blocks.empty()) {
+            BlockRecord block = {i, i, 0, 0, 0, 0};
+            blocks.push_back(block);
+        }
+        blocks.back().last = i;
+    }
+    return blocks;
+}
+
+void PcProfile::print(const APEX_Instruction *code, int size,
+                      int max_blocks) {
+    records.resize(max((int) records.size(), size));
+
+    vector<BlockRecord> blocks = find_blocks(code, size);
+    long total_retired = 0;
+    for (int b = 0; b < (int) blocks.size(); b++) {
+        BlockRecord &block = blocks[b];
+        block.executions = records[block.first].retired;
+        for (int i = block.first; i <= block.last; i++) {
+            block.retired += records[i].retired;
+            block.squashed += records[i].squashed;
+            block.head_stall_cycles += records[i].head_stall_cycles;
+        }
+        total_retired += block.retired;
+    }
+    sort(blocks.begin(), blocks.end(), hotter_block);
+
+    printf("\n\n============== HOT BASIC BLOCKS =============\n\n");
+    printf("%-8s %-8s %-8s %-10s %-8s %-10s %-10s\n", "from pc", "to pc",
+           "execs", "retired", "share%", "squashed", "head-stall");
+    for (int b = 0; b < (int) blocks.size() && b < max_blocks; b++) {
+        BlockRecord &block = blocks[b];
+        if (!block.retired && !block.squashed)
+            break;
+        printf("%-8d %-8d %-8ld %-10ld %-8.1f %-10ld %-10ld\n",
+               4000 + 4 * block.first, 4000 + 4 * block.last,
+               block.executions, block.retired,
+               total_retired ? 100.0 * block.retired / total_retired : 0.0,
+               block.squashed, block.head_stall_cycles);
+    }
+
+    // Instructions that blocked retirement the longest
+    vector<pair<long, int> > order;
+    for (int i = 0; i < size; i++) {
+        if (records[i].head_stall_cycles)
+            order.push_back(make_pair(-records[i].head_stall_cycles, i));
+    }
+    sort(order.begin(), order.end());
+
+    printf("\nROB head stalls:\n");
+    printf("%-8s %-8s %-8s %-8s %-8s %-8s %-10s\n", "pc", "opcode",
+           "fetched", "issued", "squashed", "retired", "head-stall");
+    for (int k = 0; k < (int) order.size() && k < max_blocks; k++) {
+        int i = order[k].second;
+        PcRecord &rec = records[i];
+        printf("%-8d %-8s %-8ld %-8ld %-8ld %-8ld %-10ld\n", 4000 + 4 * i,
+               code[i].opcode, rec.fetched, rec.issued, rec.squashed,
+               rec.retired, rec.head_stall_cycles);
+    }
+}
+
+bool PcProfile::write_csv(const char *filename, const APEX_Instruction *code,
+                          int size) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+        return false;
+
+    records.resize(max((int) records.size(), size));
+    fprintf(fp, "pc,opcode,fetched,issued,squashed,retired,"
+                "head_stall_cycles\n");
+    for (int i = 0; i < size; i++) {
+        PcRecord &rec = records[i];
+        fprintf(fp, "%d,%s,%ld,%ld,%ld,%ld,%ld\n", 4000 + 4 * i,
+                code[i].opcode, rec.fetched, rec.issued, rec.squashed,
+                rec.retired, rec.head_stall_cycles);
+    }
+    fclose(fp);
+    return true;
+}
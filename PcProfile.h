@@ -0,0 +1,44 @@
+/*
+ * PcProfile.h
+ *
+ *  Per static pc counts of fetched, issued, squashed and retired
+ *  instructions and of the cycles each one held the ROB head while
+ *  incomplete, with a report of the hottest basic blocks.
+ */
+
+#ifndef PCPROFILE_H_
+#define PCPROFILE_H_
+
+#include <vector>
+#include "helper.h"
+using namespace std;
+
+struct APEX_Instruction;
+
+struct PcRecord {
+    long fetched;
+    long issued;            // Left the IQ for a function unit
+    long squashed;          // Dropped by a branch flush after fetch
+    long retired;
+    long head_stall_cycles; // Cycles at the ROB head, not yet complete
+
+    PcRecord();
+};
+
+class PcProfile {
+public:
+    vector<PcRecord> records;   // Indexed by get_code_index(pc)
+    PcRecord ignored;           // Returned by at() for other pcs
+    bool frozen;                // Region of interest closed, at() ignores
+
+    PcProfile();
+    void resize(int size);      // One record per program instruction
+    void reset();
+    void freeze();
+    PcRecord &at(int pc);
+    void print(const APEX_Instruction *code, int size, int max_blocks);
+    bool write_csv(const char *filename, const APEX_Instruction *code,
+                   int size);
+};
+
+#endif /* PCPROFILE_H_ */
@@ -0,0 +1,106 @@
+/*
+ * StallStats.cpp
+ *
+ *  Per-cycle classification of every pipeline stage.
+ */
+
+#include <stdio.h>
+#include "StallStats.h"
+
+static const char *stall_reason_names[NUM_STALL_REASONS] = {
+        "busy", "idle", "ROB full", "IQ full", "LSQ full", "no URF reg",
+        "no CFID", "MUL busy", "mem busy", "exec wait", "branch flush",
+        "HALT"
+};
+
+StallStats::StallStats(int num_stages) {
+    this->num_stages = num_stages;
+    current.assign(num_stages, STALL_EMPTY);
+    counts.assign(num_stages, vector<long>(NUM_STALL_REASONS, 0));
+    for (int i = 0; i < NUM_STALL_REASONS; i++)
+        top_down[i] = 0;
+    cycles = 0;
+    frozen = false;
+}
+
+/*
+ * Start of the region of interest: the counts go back to zero. The
+ * classification of the cycle in progress is kept, so it is still counted.
+ */
+void StallStats::reset() {
+    counts.assign(num_stages, vector<long>(NUM_STALL_REASONS, 0));
+    for (int i = 0; i < NUM_STALL_REASONS; i++)
+        top_down[i] = 0;
+    cycles = 0;
+    frozen = false;
+}
+
+/*
+ * End of the region of interest: stages still report their reasons to each
+ * other through set/get, but cycles are no longer counted.
+ */
+void StallStats::freeze() {
+    frozen = true;
+}
+
+void StallStats::begin_cycle() {
+    for (int i = 0; i < num_stages; i++)
+        current[i] = STALL_EMPTY;
+}
+
+// Useful work wins over any stall recorded for the same stage in a cycle.
+void StallStats::set(int stage, int reason) {
+    if (current[stage] != STALL_NONE)
+        current[stage] = reason;
+}
+
+int StallStats::get(int stage) {
+    return current[stage];
+}
+
+/*
+ * Accumulates this cycle. The top-down root cause is the reason of the
+ * first stage in dispatch_chain that was not simply idle, i.e. a cycle
+ * with nothing to dispatch is charged to whatever starved the queue.
+ */
+void StallStats::end_cycle() {
+    if (frozen)
+        return;
+    for (int i = 0; i < num_stages; i++)
+        counts[i][current[i]]++;
+
+    int root = STALL_EMPTY;
+    for (int i = 0; i < (int) dispatch_chain.size(); i++) {
+        root = current[dispatch_chain[i]];
+        if (root != STALL_EMPTY)
+            break;
+    }
+    top_down[root]++;
+    cycles++;
+}
+
+void StallStats::print(const char *const *stage_names) {
+    if (!cycles)
+        return;
+
+    printf("\n\n============== STALL BREAKDOWN (%% of %ld cycles) =============\n\n",
+           cycles);
+    printf("%-12s", "");
+    for (int r = 0; r < NUM_STALL_REASONS; r++)
+        printf(" %-12s", stall_reason_names[r]);
+    printf("\n");
+
+    for (int s = 0; s < num_stages; s++) {
+        printf("%-12s", stage_names[s]);
+        for (int r = 0; r < NUM_STALL_REASONS; r++)
+            printf(" %-12.1f", 100.0 * counts[s][r] / cycles);
+        printf("\n");
+    }
+
+    printf("\nTop-down (dispatch slot):\n");
+    for (int r = 0; r < NUM_STALL_REASONS; r++) {
+        if (top_down[r])
+            printf("    %-14s %6.1f%%  (%ld cycles)\n", stall_reason_names[r],
+                   100.0 * top_down[r] / cycles, top_down[r]);
+    }
+}
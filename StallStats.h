@@ -0,0 +1,51 @@
+/*
+ * StallStats.h
+ *
+ *  Per-cycle classification of every pipeline stage and the top-down
+ *  breakdown derived from it.
+ */
+
+#ifndef STALLSTATS_H_
+#define STALLSTATS_H_
+
+#include <vector>
+#include "helper.h"
+using namespace std;
+
+enum {
+    STALL_NONE,         // Stage did useful work
+    STALL_EMPTY,        // Nothing to work on
+    STALL_ROB_FULL,
+    STALL_IQ_FULL,
+    STALL_LSQ_FULL,
+    STALL_NO_URF,
+    STALL_NO_CFID,
+    STALL_MUL_BUSY,
+    STALL_MEM_BUSY,
+    STALL_EXEC_WAIT,    // ROB head still waiting on its operands / FU
+    STALL_FLUSH,
+    STALL_HALT,
+    NUM_STALL_REASONS
+};
+
+class StallStats {
+public:
+    int num_stages;
+    vector<int> current;
+    vector< vector<long> > counts;
+    vector<int> dispatch_chain;         // Stages walked to find the root cause
+    long top_down[NUM_STALL_REASONS];
+    long cycles;
+    bool frozen;                        // Classify only, count nothing
+
+    StallStats(int num_stages);
+    void reset();
+    void freeze();
+    void begin_cycle();
+    void set(int stage, int reason);
+    int get(int stage);
+    void end_cycle();
+    void print(const char *const *stage_names);
+};
+
+#endif /* STALLSTATS_H_ */
@@ -0,0 +1,293 @@
+/*
+ * StatRegistry.cpp
+ *
+ *  Registry of named statistics and their JSON/CSV export.
+ */
+
+#include <string.h>
+#include "StatRegistry.h"
+
+Stat::Stat(const char *name, const char *desc, int kind, int num_threads)
+        : name(name), desc(desc), kind(kind), count(num_threads, 0),
+          sum(num_threads, 0), buckets(num_threads) {
+    bucket_width = 1;
+    frozen = false;
+    numerator = NULL;
+    denominator = NULL;
+    scale = 1.0;
+}
+
+double Stat::value(int thread) const {
+    if (kind == STAT_FORMULA) {
+        double den = denominator ? denominator->value(thread) : 1.0;
+        return den ? scale * numerator->value(thread) / den : 0.0;
+    }
+
+    const vector<long> &c = frozen ? held_count : count;
+    const vector<long> &s = frozen ? held_sum : sum;
+    long n = 0, total = 0;
+    for (int t = 0; t < (int) c.size(); t++) {
+        if (thread >= 0 && t != thread)
+            continue;
+        n += c[t];
+        total += s[t];
+    }
+    if (kind == STAT_COUNTER)
+        return n;
+    return n ? (double) total / n : 0.0;
+}
+
+long Stat::samples(int thread) const {
+    const vector<long> &c = frozen ? held_count : count;
+    long n = 0;
+    for (int t = 0; t < (int) c.size(); t++) {
+        if (thread < 0 || t == thread)
+            n += c[t];
+    }
+    return n;
+}
+
+long Stat::bucket(int index, int thread) const {
+    const vector< vector<long> > &b = frozen ? held_buckets : buckets;
+    long n = 0;
+    for (int t = 0; t < (int) b.size(); t++) {
+        if (thread < 0 || t == thread)
+            n += b[t][index];
+    }
+    return n;
+}
+
+void Stat::reset() {
+    frozen = false;
+    for (int t = 0; t < (int) count.size(); t++) {
+        count[t] = 0;
+        sum[t] = 0;
+        buckets[t].assign(buckets[t].size(), 0);
+    }
+}
+
+// End of the region of interest: later updates are no longer reported.
+void Stat::freeze() {
+    frozen = true;
+    held_count = count;
+    held_sum = sum;
+    held_buckets = buckets;
+}
+
+StatRegistry::StatRegistry(int num_threads) {
+    this->num_threads = num_threads;
+    json_fp = NULL;
+    csv_fp = NULL;
+    snapshots = 0;
+}
+
+StatRegistry::~StatRegistry() {
+    close();
+    for (int i = 0; i < (int) stats.size(); i++)
+        delete stats[i];
+}
+
+// Registering a name twice hands back the first stat.
+Stat *StatRegistry::add(Stat *stat) {
+    map<string, Stat *>::iterator itr = by_name.find(stat->name);
+    if (itr != by_name.end()) {
+        fprintf(stderr, "APEX_CPU : Statistic %s registered twice\n",
+                stat->name.c_str());
+        delete stat;
+        return itr->second;
+    }
+    stats.push_back(stat);
+    by_name[stat->name] = stat;
+    return stat;
+}
+
+Stat *StatRegistry::counter(const char *name, const char *desc) {
+    return add(new Stat(name, desc, STAT_COUNTER, num_threads));
+}
+
+Stat *StatRegistry::average(const char *name, const char *desc) {
+    return add(new Stat(name, desc, STAT_AVERAGE, num_threads));
+}
+
+Stat *StatRegistry::histogram(const char *name, const char *desc,
+                              int num_buckets, int bucket_width) {
+    Stat *stat = new Stat(name, desc, STAT_HISTOGRAM, num_threads);
+    stat->bucket_width = bucket_width > 0 ? bucket_width : 1;
+    for (int t = 0; t < num_threads; t++)
+        stat->buckets[t].assign(num_buckets > 0 ? num_buckets : 1, 0);
+    return add(stat);
+}
+
+Stat *StatRegistry::formula(const char *name, const char *desc,
+                            const Stat *numerator, const Stat *denominator,
+                            double scale) {
+    Stat *stat = new Stat(name, desc, STAT_FORMULA, num_threads);
+    stat->numerator = numerator;
+    stat->denominator = denominator;
+    stat->scale = scale;
+    return add(stat);
+}
+
+Stat *StatRegistry::find(const char *name) {
+    map<string, Stat *>::iterator itr = by_name.find(name);
+    return itr != by_name.end() ? itr->second : NULL;
+}
+
+// Start of the region of interest: every stored value goes back to zero.
+void StatRegistry::reset() {
+    for (int i = 0; i < (int) stats.size(); i++)
+        stats[i]->reset();
+}
+
+void StatRegistry::freeze() {
+    for (int i = 0; i < (int) stats.size(); i++)
+        stats[i]->freeze();
+}
+
+bool StatRegistry::open(const char *json_file, const char *csv_file) {
+    if (json_file) {
+        json_fp = fopen(json_file, "w");
+        if (!json_fp)
+            return false;
+        fprintf(json_fp, "{\n  \"threads\": %d,\n  \"snapshots\": [",
+                num_threads);
+    }
+    if (csv_file) {
+        csv_fp = fopen(csv_file, "w");
+        if (!csv_fp)
+            return false;
+        fprintf(csv_fp, "cycle,stat,thread,value,description\n");
+    }
+    return true;
+}
+
+static void write_json_value(FILE *fp, const Stat *stat, int thread) {
+    if (stat->kind == STAT_COUNTER) {
+        fprintf(fp, "%.0f", stat->value(thread));
+    } else if (stat->kind == STAT_HISTOGRAM) {
+        fprintf(fp, "{\"mean\": %.6g, \"samples\": %ld, \"bucket_width\": %d, "
+                "\"buckets\": [", stat->value(thread), stat->samples(thread),
+                stat->bucket_width);
+        for (int i = 0; i < (int) stat->buckets[0].size(); i++)
+            fprintf(fp, "%s%ld", i ? ", " : "", stat->bucket(i, thread));
+        fprintf(fp, "]}");
+    } else {
+        fprintf(fp, "%.6g", stat->value(thread));
+    }
+}
+
+/*
+ * Writes the stats as nested objects, one level per dotted path component.
+ * by_name is sorted, so the stats of a group are always adjacent.
+ */
+void StatRegistry::write_json(int clock) {
+    FILE *fp = json_fp;
+    fprintf(fp, "%s\n    {\"cycle\": %d, \"stats\": {", snapshots ? "," : "",
+            clock);
+
+    vector<string> open_groups;
+    vector<bool> started(1, false);     // Level already has a member
+    for (map<string, Stat *>::iterator itr = by_name.begin();
+         itr != by_name.end(); itr++) {
+        vector<string> parts;
+        const string &name = itr->first;
+        size_t begin = 0, dot;
+        while ((dot = name.find('.', begin)) != string::npos) {
+            parts.push_back(name.substr(begin, dot - begin));
+            begin = dot + 1;
+        }
+        parts.push_back(name.substr(begin));
+
+        size_t common = 0;
+        while (common < open_groups.size() && common + 1 < parts.size()
+               && open_groups[common] == parts[common])
+            common++;
+        while (open_groups.size() > common) {
+            fprintf(fp, "\n%*s}", 6 + 2 * (int) open_groups.size(), "");
+            open_groups.pop_back();
+            started.pop_back();
+        }
+        while (open_groups.size() + 1 < parts.size()) {
+            const string &group = parts[open_groups.size()];
+            fprintf(fp, "%s\n%*s\"%s\": {", started.back() ? "," : "",
+                    8 + 2 * (int) open_groups.size(), "", group.c_str());
+            started.back() = true;
+            open_groups.push_back(group);
+            started.push_back(false);
+        }
+
+        fprintf(fp, "%s\n%*s\"%s\": ", started.back() ? "," : "",
+                8 + 2 * (int) open_groups.size(), "", parts.back().c_str());
+        started.back() = true;
+        if (num_threads == 1) {
+            write_json_value(fp, itr->second, -1);
+        } else {
+            fprintf(fp, "{\"total\": ");
+            write_json_value(fp, itr->second, -1);
+            fprintf(fp, ", \"threads\": [");
+            for (int t = 0; t < num_threads; t++) {
+                fprintf(fp, "%s", t ? ", " : "");
+                write_json_value(fp, itr->second, t);
+            }
+            fprintf(fp, "]}");
+        }
+    }
+    while (!open_groups.empty()) {
+        fprintf(fp, "\n%*s}", 6 + 2 * (int) open_groups.size(), "");
+        open_groups.pop_back();
+    }
+    fprintf(fp, "\n    }}");
+}
+
+static void write_csv_rows(FILE *fp, int clock, const Stat *stat,
+                           int thread) {
+    char thread_name[16];
+    if (thread < 0)
+        strcpy(thread_name, "all");
+    else
+        snprintf(thread_name, sizeof(thread_name), "%d", thread);
+
+    fprintf(fp, "%d,%s,%s,%.6g,\"%s\"\n", clock, stat->name.c_str(),
+            thread_name, stat->value(thread), stat->desc.c_str());
+    if (stat->kind != STAT_HISTOGRAM)
+        return;
+    for (int i = 0; i < (int) stat->buckets[0].size(); i++)
+        fprintf(fp, "%d,%s[%d],%s,%ld,\n", clock, stat->name.c_str(),
+                i * stat->bucket_width, thread_name, stat->bucket(i, thread));
+}
+
+/*
+ * One row per stat and thread plus "all" for the sum over threads,
+ * histograms add a "name[lo]" row per bucket.
+ */
+void StatRegistry::write_csv(int clock) {
+    for (map<string, Stat *>::iterator itr = by_name.begin();
+         itr != by_name.end(); itr++) {
+        if (num_threads > 1) {
+            for (int t = 0; t < num_threads; t++)
+                write_csv_rows(csv_fp, clock, itr->second, t);
+        }
+        write_csv_rows(csv_fp, clock, itr->second, -1);
+    }
+}
+
+// Appends one snapshot of every stat to the open outputs.
+void StatRegistry::dump(int clock) {
+    if (json_fp)
+        write_json(clock);
+    if (csv_fp)
+        write_csv(clock);
+    snapshots++;
+}
+
+void StatRegistry::close() {
+    if (json_fp) {
+        fprintf(json_fp, "\n  ]\n}\n");
+        fclose(json_fp);
+        json_fp = NULL;
+    }
+    if (csv_fp) {
+        fclose(csv_fp);
+        csv_fp = NULL;
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * StatRegistry.h
+ *
+ *  Named counters, averages, histograms and formulas the pipeline units
+ *  register under dotted paths ("rob.occupancy"), kept per hardware thread,
+ *  reset at the start of the region of interest, frozen at its end and
+ *  exported as JSON or CSV snapshots.
+ */
+
+#ifndef STATREGISTRY_H_
+#define STATREGISTRY_H_
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+enum {
+    STAT_COUNTER,       // Running total
+    STAT_AVERAGE,       // Mean of the samples
+    STAT_HISTOGRAM,     // Mean and distribution of the samples
+    STAT_FORMULA        // scale * numerator / denominator, never stored
+};
+
+class Stat {
+public:
+    string name;
+    string desc;
+    int kind;
+    vector<long> count;                 // Counter value or number of samples
+    vector<long> sum;                   // Sum of the samples
+    vector< vector<long> > buckets;     // Last bucket also takes overflow
+    int bucket_width;
+    bool frozen;                        // Report the held values only
+    vector<long> held_count;
+    vector<long> held_sum;
+    vector< vector<long> > held_buckets;
+    const Stat *numerator;
+    const Stat *denominator;            // NULL divides by 1
+    double scale;
+
+    Stat(const char *name, const char *desc, int kind, int num_threads);
+
+    void inc(long n = 1, int thread = 0) {
+        count[thread] += n;
+    }
+
+    void sample(long value, int thread = 0) {
+        count[thread]++;
+        sum[thread] += value;
+        if (kind == STAT_HISTOGRAM) {
+            vector<long> &b = buckets[thread];
+            long i = value < 0 ? 0 : value / bucket_width;
+            b[i < (long) b.size() ? i : b.size() - 1]++;
+        }
+    }
+
+    double value(int thread) const;     // thread -1 sums all threads
+    long samples(int thread) const;
+    long bucket(int index, int thread) const;
+    void reset();
+    void freeze();
+};
+
+class StatRegistry {
+public:
+    int num_threads;
+    vector<Stat *> stats;               // Registration order
+    map<string, Stat *> by_name;
+    FILE *json_fp;
+    FILE *csv_fp;
+    int snapshots;
+
+    StatRegistry(int num_threads);
+    ~StatRegistry();
+    Stat *counter(const char *name, const char *desc);
+    Stat *average(const char *name, const char *desc);
+    Stat *histogram(const char *name, const char *desc, int num_buckets,
+                    int bucket_width);
+    Stat *formula(const char *name, const char *desc, const Stat *numerator,
+                  const Stat *denominator, double scale);
+    Stat *find(const char *name);
+    void reset();
+    void freeze();
+    bool open(const char *json_file, const char *csv_file);
+    void dump(int clock);
+    void close();
+
+private:
+    Stat *add(Stat *stat);
+    void write_json(int clock);
+    void write_csv(int clock);
+};
+
+#endif /* STATREGISTRY_H_ */
@@ -0,0 +1,46 @@
+/*
+ * StoreBuffer.cpp
+ *
+ *  Post-commit store buffer with write combining.
+ */
+
+#include "StoreBuffer.h"
+
+StoreBuffer::StoreBuffer(int size) : size(size), drain_cycles(0) {
+}
+
+bool StoreBuffer::accepts(int address) {
+    int value;
+    return (int) entries.size() < size || forward(address, &value);
+}
+
+// A word is buffered at most once, a later STORE to it replaces the value.
+bool StoreBuffer::insert(int pc, int address, int value) {
+    for (int i = 0; i < (int) entries.size(); i++) {
+        if (entries[i].address == address) {
+            entries[i].pc = pc;
+            entries[i].value = value;
+            return true;
+        }
+    }
+    SB_Entry entry;
+    entry.pc = pc;
+    entry.address = address;
+    entry.value = value;
+    entries.push_back(entry);
+    return false;
+}
+
+bool StoreBuffer::forward(int address, int *value) {
+    for (int i = 0; i < (int) entries.size(); i++) {
+        if (entries[i].address == address) {
+            *value = entries[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+int StoreBuffer::count() {
+    return (int) entries.size();
+}
@@ -0,0 +1,39 @@
+/*
+ * StoreBuffer.h
+ *
+ *  Post-commit store buffer (--store-buffer=N). A STORE at the ROB head
+ *  leaves the LSQ into the buffer instead of holding memFU for the memory
+ *  write; the buffer writes its oldest entry to data memory in the
+ *  background, one every STORE_DRAIN_CYCLES cycles. A STORE to a word
+ *  already buffered overwrites that entry, and LOADs read the youngest
+ *  buffered value of their word before memory.
+ */
+
+#ifndef STOREBUFFER_H_
+#define STOREBUFFER_H_
+
+#include <deque>
+using namespace std;
+
+#define STORE_DRAIN_CYCLES 3
+
+struct SB_Entry {
+    int pc;             // Of the last STORE to the word, for fault reports
+    int address;
+    int value;
+};
+
+class StoreBuffer {
+public:
+    deque<SB_Entry> entries;            // Oldest first
+    int size;
+    int drain_cycles;                   // Spent on the oldest entry so far
+
+    StoreBuffer(int size);
+    bool accepts(int address);          // A free entry or the word is buffered
+    bool insert(int pc, int address, int value);    // true if coalesced
+    bool forward(int address, int *value);
+    int count();
+};
+
+#endif /* STOREBUFFER_H_ */
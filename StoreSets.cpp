@@ -0,0 +1,54 @@
+/*
+ * StoreSets.cpp
+ *
+ *  Store set memory dependence predictor.
+ */
+
+#include "StoreSets.h"
+
+StoreSets::StoreSets(int ssit_size, int lfst_size)
+        : ssit(ssit_size, -1), lfst(lfst_size, 0), next_set(0) {
+}
+
+int &StoreSets::set_of(int pc) {
+    return ssit[(pc / 4) % ssit.size()];
+}
+
+int StoreSets::dispatch_load(int pc) {
+    int set = set_of(pc);
+    return set >= 0 ? lfst[set] : 0;
+}
+
+void StoreSets::dispatch_store(int pc, int seq) {
+    int set = set_of(pc);
+    if (set >= 0)
+        lfst[set] = seq;
+}
+
+// The STORE has written memory, LOADs of its set no longer wait for it.
+void StoreSets::execute_store(int pc, int seq) {
+    int set = set_of(pc);
+    if (set >= 0 && lfst[set] == seq)
+        lfst[set] = 0;
+}
+
+/*
+ * The LOAD read memory before the STORE wrote the same address: both go
+ * into one set, a new one if neither had a set, the lower numbered one if
+ * both had.
+ */
+void StoreSets::violation(int load_pc, int store_pc) {
+    int &load_set = set_of(load_pc);
+    int &store_set = set_of(store_pc);
+    if (load_set < 0 && store_set < 0) {
+        load_set = next_set;
+        store_set = next_set;
+        next_set = (next_set + 1) % lfst.size();
+    } else if (load_set < 0) {
+        load_set = store_set;
+    } else if (store_set < 0 || load_set < store_set) {
+        store_set = load_set;
+    } else {
+        load_set = store_set;
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ * StoreSets.h
+ *
+ *  Store set memory dependence predictor (--mem-dep=1). The store set ID
+ *  table (SSIT), indexed by pc, puts a LOAD and the STOREs it has read
+ *  memory ahead of into one set. The last fetched store table (LFST) names
+ *  the youngest in-flight STORE of each set; a LOAD of the set dispatched
+ *  after it does not run ahead of that STORE.
+ */
+
+#ifndef STORESETS_H_
+#define STORESETS_H_
+
+#include <vector>
+using namespace std;
+
+#define SSIT_SIZE 1024
+#define LFST_SIZE 128
+
+class StoreSets {
+public:
+    vector<int> ssit;           // Store set of each pc index, -1 if none
+    vector<int> lfst;           // Kanata id of the set's last STORE, 0 if none
+    int next_set;
+
+    StoreSets(int ssit_size = SSIT_SIZE, int lfst_size = LFST_SIZE);
+    int dispatch_load(int pc);              // STORE to wait for, 0 if none
+    void dispatch_store(int pc, int seq);
+    void execute_store(int pc, int seq);
+    void violation(int load_pc, int store_pc);
+
+private:
+    int &set_of(int pc);
+};
+
+#endif /* STORESETS_H_ */
@@ -0,0 +1,70 @@
+/*
+ * ValuePredictor.cpp
+ *
+ *  Last-value / stride load value predictor.
+ */
+
+#include "ValuePredictor.h"
+
+ValuePredictor::ValuePredictor(int mode, int size) : table(size), mode(mode) {
+    for (int i = 0; i < size; i++) {
+        table[i].pc = -1;
+        table[i].last_value = 0;
+        table[i].stride = 0;
+        table[i].confidence = 0;
+        table[i].inflight = 0;
+    }
+}
+
+bool ValuePredictor::predict(int pc, int *value) {
+    VP_Entry &entry = table[(pc / 4) % table.size()];
+    if (entry.pc != pc)
+        return false;
+    entry.inflight++;
+    if (entry.confidence < VP_CONFIDENT)
+        return false;
+    *value = entry.last_value;
+    if (mode == VP_STRIDE)
+        *value += entry.stride * entry.inflight;
+    return true;
+}
+
+void ValuePredictor::train(int pc, int value) {
+    VP_Entry &entry = table[(pc / 4) % table.size()];
+    if (entry.pc != pc) {
+        entry.pc = pc;
+        entry.last_value = value;
+        entry.stride = 0;
+        entry.confidence = 0;
+        entry.inflight = 0;
+        return;
+    }
+
+    int expected = entry.last_value;
+    if (mode == VP_STRIDE)
+        expected += entry.stride;
+    if (expected == value) {
+        if (entry.confidence < 3)
+            entry.confidence++;
+    } else {
+        entry.confidence = 0;
+    }
+    entry.stride = value - entry.last_value;
+    entry.last_value = value;
+    if (entry.inflight > 0)
+        entry.inflight--;
+}
+
+/*
+ * Flushed lookups never train: after a flush the in-flight counts are
+ * rebuilt from the LOADs that survived it and have not read memory yet.
+ */
+void ValuePredictor::recount(const vector<int> &pcs) {
+    for (int i = 0; i < (int) table.size(); i++)
+        table[i].inflight = 0;
+    for (int i = 0; i < (int) pcs.size(); i++) {
+        VP_Entry &entry = table[(pcs[i] / 4) % table.size()];
+        if (entry.pc == pcs[i])
+            entry.inflight++;
+    }
+}
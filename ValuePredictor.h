@@ -0,0 +1,49 @@
+/*
+ * ValuePredictor.h
+ *
+ *  Load value predictor (--value-pred). A direct mapped table indexed by
+ *  load pc remembers the last value each LOAD returned and, in stride
+ *  mode, the difference between its last two values. A 2-bit confidence
+ *  counter gates the prediction: it counts up on every value the entry
+ *  would have guessed right and is cleared on a wrong one.
+ *
+ *  Loads train the table when memFU reads them, so several instances of
+ *  one LOAD may be in flight at once; each lookup advances the stride by
+ *  one more step for the instances not trained yet.
+ */
+
+#ifndef VALUEPREDICTOR_H_
+#define VALUEPREDICTOR_H_
+
+#include <vector>
+using namespace std;
+
+#define VP_TABLE_SIZE 256
+#define VP_CONFIDENT 2
+
+enum {
+    VP_OFF,
+    VP_LAST_VALUE,
+    VP_STRIDE
+};
+
+struct VP_Entry {
+    int pc;             // Tag, -1 if unused
+    int last_value;
+    int stride;
+    int confidence;     // 0..3, predicts from VP_CONFIDENT on
+    int inflight;       // Looked up, not trained yet
+};
+
+class ValuePredictor {
+public:
+    vector<VP_Entry> table;
+    int mode;                           // VP_LAST_VALUE or VP_STRIDE
+
+    ValuePredictor(int mode, int size = VP_TABLE_SIZE);
+    bool predict(int pc, int *value);   // false if not confident
+    void train(int pc, int value);
+    void recount(const vector<int> &pcs);   // PCs of untrained lookups
+};
+
+#endif /* VALUEPREDICTOR_H_ */
@@ -0,0 +1,241 @@
+/*
+ *  bench.cpp
+ *  Host throughput benchmark. Runs the simulator core over a program
+ *  suite and reports simulated cycles and retired instructions per host
+ *  second, peak RSS and, from one extra timed run, the host time of each
+ *  stage function as JSON.
+ *
+ *  usage: apex_bench [--repeat=N] [--max-cycles=N] [--json=FILE]
+ *                    [simulator options] [program ...]
+ *
+ *  Without programs the kernels in APEX_BENCH_DIR are run. Co-simulation
+ *  is off unless --cosim=1 is given.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+
+using namespace std;
+
+#ifndef APEX_BENCH_DIR
+#define APEX_BENCH_DIR "benchmarks"
+#endif
+
+static const char *const default_suite[] = {
+        "stream", "reduction", "pointer_chase", "matmul", "branchy"
+};
+
+struct Bench_Result {
+    string name;
+    int runs;
+    int halted;
+    long cycles;
+    long retired;
+    double seconds;
+    double stage_seconds[NUM_STAGE_FUNCTIONS];  // One separate timed run
+};
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/*
+ * Runs the program once, until HALT or max_cycles. Returns the host
+ * seconds of the cycle loop alone, or -1 if the program cannot be loaded.
+ */
+static double run_once(const string &path, long max_cycles,
+                       Bench_Result *result) {
+    APEX_CPU *cpu = APEX_cpu_init(path.c_str());
+    if (!cpu) {
+        fprintf(stderr, "apex_bench : cannot load %s\n", path.c_str());
+        return -1;
+    }
+
+    double start = now();
+    int halted = 0;
+    while (!halted && cpu->clock < max_cycles)
+        halted = APEX_cpu_cycle(cpu);
+    double seconds = now() - start;
+
+    if (result) {
+        result->runs++;
+        result->halted &= halted;
+        result->cycles += cpu->clock;
+        result->retired += cpu->ins_completed;
+    }
+    APEX_cpu_stop(cpu);
+    return seconds;
+}
+
+/*
+ * Runs one program 'repeat' times with the stage timers off, for the
+ * throughput figures, then once more with them on for the per-stage
+ * split, so the timers never slow down the runs being measured. Only the
+ * cycle loop is timed, loading and tearing down the CPU are not.
+ */
+static bool run_program(const string &path, int repeat, long max_cycles,
+                        Bench_Result *result) {
+    result->runs = 0;
+    result->halted = 1;
+    result->cycles = 0;
+    result->retired = 0;
+    result->seconds = 0;
+
+    apex_stage_timing = 0;
+    for (int r = 0; r < repeat; r++) {
+        double seconds = run_once(path, max_cycles, result);
+        if (seconds < 0)
+            return false;
+        result->seconds += seconds;
+    }
+
+    memset(apex_stage_seconds, 0, sizeof(apex_stage_seconds));
+    apex_stage_timing = 1;
+    double seconds = run_once(path, max_cycles, NULL);
+    apex_stage_timing = 0;
+    if (seconds < 0)
+        return false;
+    memcpy(result->stage_seconds, apex_stage_seconds,
+           sizeof(result->stage_seconds));
+    return true;
+}
+
+static void write_result(FILE *fp, const Bench_Result &r, bool last) {
+    double seconds = r.seconds > 0 ? r.seconds : 1e-9;
+    fprintf(fp, "    {\n");
+    fprintf(fp, "      \"name\": \"%s\",\n", r.name.c_str());
+    fprintf(fp, "      \"runs\": %d,\n", r.runs);
+    fprintf(fp, "      \"halted\": %s,\n", r.halted ? "true" : "false");
+    fprintf(fp, "      \"cycles\": %ld,\n", r.cycles);
+    fprintf(fp, "      \"retired\": %ld,\n", r.retired);
+    fprintf(fp, "      \"ipc\": %.4f,\n",
+            r.cycles ? (double) r.retired / r.cycles : 0.0);
+    fprintf(fp, "      \"seconds\": %.6f,\n", r.seconds);
+    fprintf(fp, "      \"cycles_per_second\": %.1f,\n", r.cycles / seconds);
+    fprintf(fp, "      \"instructions_per_second\": %.1f,\n",
+            r.retired / seconds);
+    fprintf(fp, "      \"stage_seconds\": {");
+    for (int i = 0; i < NUM_STAGE_FUNCTIONS; i++)
+        fprintf(fp, "%s\"%s\": %.6f", i ? ", " : "", stage_function_names[i],
+                r.stage_seconds[i]);
+    fprintf(fp, "}\n");
+    fprintf(fp, "    }%s\n", last ? "" : ",");
+}
+
+static const char *option_value(const char *arg, const char *name) {
+    size_t len = strlen(name);
+    if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0
+        || arg[2 + len] != '=')
+        return NULL;
+    return arg + 3 + len;
+}
+
+int main(int argc, char **argv) {
+    int repeat = 1;
+    long max_cycles = 100000000;
+    const char *json_file = "apex_bench.json";
+
+    // Benchmark options first, the rest go to the simulator
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "repeat")))
+            repeat = atoi(value);
+        else if ((value = option_value(argv[i], "max-cycles")))
+            max_cycles = atol(value);
+        else if ((value = option_value(argv[i], "json")))
+            json_file = value;
+        else
+            argv[kept++] = argv[i];
+    }
+    // Co-simulation measures the golden model too, --cosim=1 turns it on
+    apex_config.cosim = 0;
+    argc = APEX_parse_options(kept, argv);
+    if (argc < 0 || repeat < 1)
+        return 1;
+
+    vector<Bench_Result> results;
+    vector<string> paths;
+    for (int i = 1; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty()) {
+        for (size_t i = 0; i < sizeof(default_suite) / sizeof(default_suite[0]); i++)
+            paths.push_back(string(APEX_BENCH_DIR) + "/" + default_suite[i]
+                            + ".asm");
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        Bench_Result result;
+        size_t slash = paths[i].find_last_of('/');
+        result.name = paths[i].substr(slash == string::npos ? 0 : slash + 1);
+        if (!run_program(paths[i], repeat, max_cycles, &result))
+            return 1;
+        results.push_back(result);
+    }
+
+    FILE *fp = fopen(json_file, "w");
+    if (!fp) {
+        fprintf(stderr, "apex_bench : cannot write %s\n", json_file);
+        return 1;
+    }
+
+    Bench_Result total;
+    total.name = "total";
+    total.runs = 0;
+    total.halted = 1;
+    total.cycles = 0;
+    total.retired = 0;
+    total.seconds = 0;
+    memset(total.stage_seconds, 0, sizeof(total.stage_seconds));
+    for (size_t i = 0; i < results.size(); i++) {
+        total.runs += results[i].runs;
+        total.halted &= results[i].halted;
+        total.cycles += results[i].cycles;
+        total.retired += results[i].retired;
+        total.seconds += results[i].seconds;
+        for (int j = 0; j < NUM_STAGE_FUNCTIONS; j++)
+            total.stage_seconds[j] += results[i].stage_seconds[j];
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"repeat\": %d,\n", repeat);
+#ifdef APEX_STAGE_TIMING
+    fprintf(fp, "  \"stage_timing\": true,\n");
+#else
+    fprintf(fp, "  \"stage_timing\": false,\n");
+#endif
+    fprintf(fp, "  \"peak_rss_kb\": %ld,\n", peak_rss_kb());
+    fprintf(fp, "  \"programs\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+        write_result(fp, results[i], false);
+    write_result(fp, total, true);
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+    fclose(fp);
+
+    printf("\n%-16s %12s %12s %14s %14s\n", "program", "cycles", "retired",
+           "cycles/s", "instr/s");
+    results.push_back(total);
+    for (size_t i = 0; i < results.size(); i++) {
+        double seconds = results[i].seconds > 0 ? results[i].seconds : 1e-9;
+        printf("%-16s %12ld %12ld %14.0f %14.0f\n", results[i].name.c_str(),
+               results[i].cycles, results[i].retired,
+               results[i].cycles / seconds, results[i].retired / seconds);
+    }
+    printf("peak RSS %ld KB, results in %s\n", peak_rss_kb(), json_file);
+    return total.halted ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+; branchy: data dependent branches over i = 0..63
+; MEM[0] = number of even i, MEM[1] = number of i divisible by 4,
+; MEM[2] = sum of the i divisible by 4
+MOVC,R0,#0
+MOVC,R1,#0
+MOVC,R2,#64
+MOVC,R3,#1
+MOVC,R4,#3
+MOVC,R8,#0
+MOVC,R9,#0
+MOVC,R10,#0
+AND,R5,R1,R3
+BNZ,#8
+ADDL,R8,R8,#1
+AND,R5,R1,R4
+BNZ,#12
+ADDL,R9,R9,#1
+ADD,R10,R10,R1
+ADDL,R1,R1,#1
+SUB,R6,R1,R2
+BNZ,#-36
+STORE,R8,R0,#0
+STORE,R9,R0,#1
+STORE,R10,R0,#2
+HALT
@@ -0,0 +1,40 @@
+; matmul: C = A * B for 4x4 matrices stored row-major
+; A at 1000 with A[k] = k + 1, B at 1100 with every element 2, C at 1200
+MOVC,R0,#0
+MOVC,R4,#4
+MOVC,R1,#0
+MOVC,R2,#16
+MOVC,R6,#2
+ADDL,R5,R1,#1
+STORE,R5,R1,#1000
+STORE,R6,R1,#1100
+ADDL,R1,R1,#1
+SUB,R7,R1,R2
+BNZ,#-20
+; i loop
+MOVC,R1,#0
+MOVC,R2,#0
+; j loop
+MOVC,R3,#0
+MOVC,R5,#0
+MUL,R8,R1,R4
+; k loop: R5 += A[i][k] * B[k][j]
+ADD,R9,R8,R3
+LOAD,R10,R9,#1000
+MUL,R11,R3,R4
+ADD,R11,R11,R2
+LOAD,R12,R11,#1100
+MUL,R10,R10,R12
+ADD,R5,R5,R10
+ADDL,R3,R3,#1
+SUB,R7,R3,R4
+BNZ,#-36
+ADD,R9,R8,R2
+STORE,R5,R9,#1200
+ADDL,R2,R2,#1
+SUB,R7,R2,R4
+BNZ,#-68
+ADDL,R1,R1,#1
+SUB,R7,R1,R4
+BNZ,#-84
+HALT
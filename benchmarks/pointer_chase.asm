@@ -0,0 +1,26 @@
+; pointer_chase: 64 nodes at 1000, node p holds the address of the next
+; node, visited in the order p(k) = (17 * k) & 63. Walks 256 links and
+; leaves the final pointer in MEM[0].
+MOVC,R0,#0
+MOVC,R1,#0
+MOVC,R2,#64
+MOVC,R3,#63
+MOVC,R4,#17
+MOVC,R9,#0
+; MEM[1000 + p(k)] = 1000 + p(k + 1)
+ADDL,R1,R1,#1
+MUL,R5,R1,R4
+AND,R5,R5,R3
+ADDL,R6,R5,#1000
+STORE,R6,R9,#1000
+ADDL,R9,R5,#0
+SUB,R7,R1,R2
+BNZ,#-28
+; chase
+MOVC,R8,#1000
+MOVC,R1,#256
+LOAD,R8,R8,#0
+SUBL,R1,R1,#1
+BNZ,#-8
+STORE,R8,R0,#0
+HALT
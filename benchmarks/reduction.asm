@@ -0,0 +1,23 @@
+; reduction: sum of a[i] = i + 1 over 64 words at 1000, result in MEM[0]
+MOVC,R0,#0
+MOVC,R1,#0
+MOVC,R2,#64
+ADDL,R3,R1,#1
+STORE,R3,R1,#1000
+ADDL,R1,R1,#1
+SUB,R4,R1,R2
+BNZ,#-16
+; sum with two accumulators to expose some ILP
+MOVC,R1,#0
+MOVC,R5,#0
+MOVC,R6,#0
+LOAD,R3,R1,#1000
+LOAD,R4,R1,#1001
+ADD,R5,R5,R3
+ADD,R6,R6,R4
+ADDL,R1,R1,#2
+SUB,R7,R1,R2
+BNZ,#-24
+ADD,R5,R5,R6
+STORE,R5,R0,#0
+HALT
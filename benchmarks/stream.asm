@@ -0,0 +1,24 @@
+; stream: a[i] = b[i] + 3 * c[i] over 64 words
+; b at 1000, c at 2000, a at 3000
+MOVC,R0,#0
+MOVC,R1,#0
+MOVC,R2,#64
+MOVC,R3,#3
+MOVC,R4,#2
+; b[i] = i, c[i] = 2
+STORE,R1,R1,#1000
+STORE,R4,R1,#2000
+ADDL,R1,R1,#1
+SUB,R5,R1,R2
+BNZ,#-16
+; triad
+MOVC,R1,#0
+LOAD,R5,R1,#1000
+LOAD,R6,R1,#2000
+MUL,R6,R6,R3
+ADD,R5,R5,R6
+STORE,R5,R1,#3000
+ADDL,R1,R1,#1
+SUB,R7,R1,R2
+BNZ,#-28
+HALT
@@ -0,0 +1,153 @@
+/*
+ *  config.cpp
+ *  Parses the --name=value run-time options of the simulator
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+APEX_Config apex_config = {
+		NULL,		// kanata_file
+		NULL,		// assemble_file
+		NULL,		// image_cache_dir
+		2147483647L,	// mem_limit
+		1,			// mem_align
+		NULL,		// mem_image
+		0,			// mem_image_base
+		NULL,		// mem_dump
+		NULL,		// state_dump
+		NULL,		// expect_image
+		1,			// cosim
+		NULL,		// stats_json
+		NULL,		// stats_csv
+		0,			// stats_interval
+		0,			// warmup_insns
+		0,			// warmup_cycles
+		0,			// roi_insns
+		3,			// commit_width
+		0,			// early_release
+		0,			// move_elim
+		0,			// fusion
+		0,			// value_pred
+		0,			// mem_dep
+		0,			// store_buffer
+};
+
+/*
+ * Returns the value of "--name=value" if arg is that option, else NULL.
+ */
+static const char*
+option_value(const char* arg, const char* name) {
+	size_t len = strlen(name);
+	if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0
+			|| arg[2 + len] != '=') {
+		return NULL;
+	}
+	return arg + 3 + len;
+}
+
+/*
+ * Consumes every --name=value option in argv into apex_config and
+ * compacts the remaining arguments to the front of argv.
+ * Returns the new argc, or -1 on an unknown option.
+ */
+int
+APEX_parse_options(int argc, char** argv) {
+	int kept = 1;
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		const char* value;
+
+		if (strncmp(arg, "--", 2) != 0) {
+			argv[kept++] = argv[i];
+			continue;
+		}
+
+		if ((value = option_value(arg, "kanata"))) {
+			apex_config.kanata_file = value;
+		} else if ((value = option_value(arg, "assemble"))) {
+			apex_config.assemble_file = value;
+		} else if ((value = option_value(arg, "image-cache"))) {
+			apex_config.image_cache_dir = value;
+		} else if ((value = option_value(arg, "mem-limit"))) {
+			apex_config.mem_limit = atol(value);
+		} else if ((value = option_value(arg, "mem-align"))) {
+			apex_config.mem_align = atoi(value);
+		} else if ((value = option_value(arg, "mem-image"))) {
+			// --mem-image=<file>[@<base word address>]
+			const char* at = strrchr(value, '@');
+			if (at) {
+				// The file part is copied, argv is left as it was
+				size_t len = at - value;
+				char* file = (char*) malloc(len + 1);
+				if (!file) {
+					fprintf(stderr, "APEX_CPU : Out of memory for %s\n",
+							arg);
+					return -1;
+				}
+				memcpy(file, value, len);
+				file[len] = '\0';
+				apex_config.mem_image_base = atoi(at + 1);
+				value = file;
+			}
+			apex_config.mem_image = value;
+		} else if ((value = option_value(arg, "mem-dump"))) {
+			apex_config.mem_dump = value;
+		} else if ((value = option_value(arg, "state-dump"))) {
+			apex_config.state_dump = value;
+		} else if ((value = option_value(arg, "expect"))) {
+			apex_config.expect_image = value;
+		} else if ((value = option_value(arg, "cosim"))) {
+			apex_config.cosim = atoi(value);
+		} else if ((value = option_value(arg, "stats-json"))) {
+			apex_config.stats_json = value;
+		} else if ((value = option_value(arg, "stats-csv"))) {
+			apex_config.stats_csv = value;
+		} else if ((value = option_value(arg, "stats-interval"))) {
+			apex_config.stats_interval = atoi(value);
+		} else if ((value = option_value(arg, "warmup-insns"))) {
+			apex_config.warmup_insns = atol(value);
+		} else if ((value = option_value(arg, "warmup-cycles"))) {
+			apex_config.warmup_cycles = atol(value);
+		} else if ((value = option_value(arg, "roi-insns"))) {
+			apex_config.roi_insns = atol(value);
+		} else if ((value = option_value(arg, "commit-width"))) {
+			apex_config.commit_width = atoi(value);
+			if (apex_config.commit_width < 1) {
+				fprintf(stderr, "APEX_CPU : --commit-width must be at least 1\n");
+				return -1;
+			}
+		} else if ((value = option_value(arg, "early-release"))) {
+			apex_config.early_release = atoi(value);
+		} else if ((value = option_value(arg, "move-elim"))) {
+			apex_config.move_elim = atoi(value);
+		} else if ((value = option_value(arg, "fusion"))) {
+			apex_config.fusion = atoi(value);
+		} else if ((value = option_value(arg, "value-pred"))) {
+			apex_config.value_pred = atoi(value);
+			if (apex_config.value_pred < 0 || apex_config.value_pred > 2) {
+				fprintf(stderr, "APEX_CPU : --value-pred must be 0, 1 or 2\n");
+				return -1;
+			}
+		} else if ((value = option_value(arg, "mem-dep"))) {
+			apex_config.mem_dep = atoi(value);
+			if (apex_config.mem_dep < 0 || apex_config.mem_dep > 2) {
+				fprintf(stderr, "APEX_CPU : --mem-dep must be 0, 1 or 2\n");
+				return -1;
+			}
+		} else if ((value = option_value(arg, "store-buffer"))) {
+			apex_config.store_buffer = atoi(value);
+			if (apex_config.store_buffer < 0) {
+				fprintf(stderr, "APEX_CPU : --store-buffer must not be negative\n");
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "APEX_CPU : Unknown option %s\n", arg);
+			return -1;
+		}
+	}
+	argv[kept] = NULL;
+	return kept;
+}
@@ -0,0 +1,42 @@
+/*
+ *  config.h
+ *  Run-time options of the simulator. Options are given on the command
+ *  line as --name=value ahead of the usual positional arguments.
+ */
+
+#ifndef _APEX_CONFIG_H_
+#define _APEX_CONFIG_H_
+
+typedef struct APEX_Config {
+	const char* kanata_file;	// Kanata pipeline log, NULL to disable
+	const char* assemble_file;	// Assembler mode: write the binary image here and exit
+	const char* image_cache_dir;	// Directory of cached binary images, NULL to disable
+	long mem_limit;			// Data memory size in words, accesses above fault
+	int mem_align;			// Data addresses must be a multiple of this
+	const char* mem_image;		// Initial data memory, raw 32-bit words
+	int mem_image_base;		// Word address mem_image is loaded at
+	const char* mem_dump;		// Final data memory as raw 32-bit words
+	const char* state_dump;		// Final registers and compressed memory
+	const char* expect_image;	// Raw image the final memory is compared to
+	int cosim;			// Check every commit against the golden model
+	const char* stats_json;		// Statistics registry snapshots as JSON
+	const char* stats_csv;		// Statistics registry snapshots as CSV
+	int stats_interval;		// Cycles between snapshots, 0 for only the final one
+	long warmup_insns;		// Region of interest starts after this many commits
+	long warmup_cycles;		// ... or after this many cycles
+	long roi_insns;			// Region of interest ends after this many commits
+	int commit_width;		// Instructions retired from the ROB head per cycle
+	int early_release;		// Free a replaced mapping before its redefinition commits
+	int move_elim;			// Resolve copies and constants in the rename map
+	int fusion;			// Fuse ADD/SUB/SUBL with a following BZ/BNZ
+	int value_pred;			// Load value prediction: 0 off, 1 last value, 2 stride
+	int mem_dep;			// LOADs ahead of older STOREs: 0 never, 1 store sets, 2 always
+	int store_buffer;		// Post-commit store buffer entries, 0 for none
+} APEX_Config;
+
+extern APEX_Config apex_config;
+
+int
+APEX_parse_options(int argc, char** argv);
+
+#endif
@@ -7,6 +7,8 @@
 #include <string.h>
 
 #include "cpu.h"
+#include "program_image.h"
+#include "GoldenModel.h"
 #include "ROB.h"
 #include "LSQ.h"
 #include "BTB.h"
@@ -16,12 +18,54 @@
 
 using namespace std;
 
-/* Set this flag to 1 to enable debug messages */
+/* Set this flag to 1 to enable debug messages, builds without tracing
+ * (such as the benchmark) define it to 0 */
+#ifndef ENABLE_DEBUG_MESSAGES
 #define ENABLE_DEBUG_MESSAGES 1
+#endif
+/* Machine-readable per branch-PC statistics written at the end of simulate() */
+#define BRANCH_STATS_FILE "branch_stats.csv"
+/* Per-pc execution profile written next to it */
+#define PC_PROFILE_FILE "pc_profile.csv"
+/* Magic of the --state-dump file */
+#define STATE_DUMP_MAGIC "APEXDMP1"
+/* Memory mismatches printed by --expect, the rest are only counted */
+#define MAX_REPORTED_MISMATCHES 20
 int iMulCycleSpent = 0;
 int memCycleSpent = 0;
+int memEarlyLoad = 0;   // memFU runs a LOAD ahead of the LSQ head
 int isHalt = 0;
-int AnyInstructionRetired = 0;
+int isHaltDecoded = 0;
+
+double apex_stage_seconds[NUM_STAGE_FUNCTIONS];
+int apex_stage_timing = 0;
+const char *const stage_function_names[NUM_STAGE_FUNCTIONS] = {
+        "commit", "memFU", "intFU", "mulFU", "addToQueues",
+        "decode", "fetch"
+};
+
+#ifdef APEX_STAGE_TIMING
+#include <time.h>
+#define TIMED_STAGE(id, call)                                               \
+    do {                                                                    \
+        if (!apex_stage_timing) {                                           \
+            call;                                                           \
+            break;                                                          \
+        }                                                                   \
+        struct timespec start_, end_;                                       \
+        clock_gettime(CLOCK_MONOTONIC, &start_);                            \
+        call;                                                               \
+        clock_gettime(CLOCK_MONOTONIC, &end_);                              \
+        apex_stage_seconds[id] += (end_.tv_sec - start_.tv_sec)             \
+                                  + (end_.tv_nsec - start_.tv_nsec) * 1e-9; \
+    } while (0)
+#else
+#define TIMED_STAGE(id, call) call
+#endif
+
+static const char *const stage_names[NUM_STAGES] = {
+        "Fetch", "Decode/RF", "QUEUE", "INT FU", "MUL FU", "MEMORY FU", "Retire"
+};
 
 // Bus Logic
 
@@ -54,18 +98,382 @@ int comparator_rs2(APEX_CPU *cpu, CPU_Stage *stage) {
  * 				implementation
  */
 
+/*
+ * Decodes the per-instruction metadata fetch and retire need, so that they
+ * can index it by pc instead of comparing opcode strings. Returns NULL if
+ * the table cannot be allocated.
+ */
+static APEX_Decoded_Instruction *
+build_instruction_table(APEX_Instruction *code_memory, int size) {
+    APEX_Decoded_Instruction *itable = (APEX_Decoded_Instruction *) malloc(
+            sizeof(*itable) * size);
+    if (!itable)
+        return NULL;
+    for (int i = 0; i < size; i++) {
+        int op = code_memory[i].op;
+        itable[i].op = op;
+        itable[i].fu_type = INT_FU;
+        if (op == OP_MUL)
+            itable[i].fu_type = MUL_FU;
+        else if (op == OP_LOAD || op == OP_STORE)
+            itable[i].fu_type = LS_FU;
+        itable[i].is_control_flow = op == OP_BZ || op == OP_BNZ
+                                    || op == OP_JUMP || op == OP_JAL;
+        itable[i].is_mem = op == OP_LOAD || op == OP_STORE;
+        itable[i].writes_rd = op == OP_MOVC || op == OP_LOAD || op == OP_JAL
+                              || op == OP_ADD || op == OP_ADDL || op == OP_SUB
+                              || op == OP_SUBL || op == OP_MUL || op == OP_AND
+                              || op == OP_OR || op == OP_EXOR;
+        itable[i].sets_flag = itable[i].writes_rd && op != OP_MOVC
+                              && op != OP_LOAD && op != OP_JAL;
+    }
+    return itable;
+}
+
+/*
+ * Creates the branch, stall, occupancy, lifecycle and per-pc tables. Stall
+ * attribution charges a cycle with nothing dispatched to the first of
+ * QUEUE, D/RF and Fetch that reported a reason.
+ */
+static void new_pipeline_stats(APEX_CPU *cpu) {
+    cpu->branch_stats = new BranchStats();
+
+    cpu->stalls = new StallStats(NUM_STAGES);
+    cpu->stalls->dispatch_chain.push_back(QUEUE);
+    cpu->stalls->dispatch_chain.push_back(DRF);
+    cpu->stalls->dispatch_chain.push_back(F);
+
+    cpu->occupancy = new OccupancyStats();
+    cpu->occupancy->set_capacity(OCC_IQ, "IQ", IQ_SIZE);
+    cpu->occupancy->set_capacity(OCC_ROB, "ROB", ROB_SIZE);
+    cpu->occupancy->set_capacity(OCC_LSQ, "LSQ", LSQ_SIZE);
+    cpu->occupancy->set_capacity(OCC_URF, "URF", URF_SIZE);
+    cpu->occupancy->set_capacity(OCC_CFID, "CFID", CFID_SIZE);
+
+    cpu->lifecycle = new LifecycleStats();
+    cpu->profile = new PcProfile();
+    cpu->profile->resize(cpu->code_memory_size);
+}
+
+/*
+ * Empties the tables. The stall classification of the cycle in progress
+ * carries over, so the cycle is still counted.
+ */
+static void reset_pipeline_stats(APEX_CPU *cpu) {
+    cpu->branch_stats->reset();
+    cpu->stalls->reset();
+    cpu->occupancy->reset();
+    cpu->lifecycle->reset();
+    cpu->profile->reset();
+}
+
+// Stops the tables counting, they keep what they hold for the report.
+static void freeze_pipeline_stats(APEX_CPU *cpu) {
+    cpu->branch_stats->freeze();
+    cpu->stalls->freeze();
+    cpu->occupancy->freeze();
+    cpu->lifecycle->freeze();
+    cpu->profile->freeze();
+}
+
+/*
+ * Registers the statistics of every unit. The core is single threaded, so
+ * everything is kept for thread 0.
+ */
+static void register_stats(APEX_CPU *cpu) {
+    static const char *const occ_names[NUM_OCC_STRUCTURES] = {
+            "iq", "rob", "lsq", "urf", "btb.cfid"
+    };
+    static const int occ_capacity[NUM_OCC_STRUCTURES] = {
+            IQ_SIZE, ROB_SIZE, LSQ_SIZE, URF_SIZE, CFID_SIZE
+    };
+    static const char *const fu_names[3] = {"int", "mul", "mem"};
+
+    StatRegistry *stats = new StatRegistry(1);
+    APEX_Stats *stat = &cpu->stat;
+    cpu->stats = stats;
+
+    stat->cycles = stats->counter("core.cycles", "Simulated cycles");
+    stat->retired = stats->counter("core.retired", "Retired instructions");
+    stats->formula("core.ipc", "Retired instructions per cycle",
+                   stat->retired, stat->cycles, 1.0);
+
+    for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s.occupancy", occ_names[s]);
+        stat->occupancy[s] = stats->histogram(name, "Entries in use per cycle",
+                                              occ_capacity[s] + 1, 1);
+        snprintf(name, sizeof(name), "%s.full_cycles", occ_names[s]);
+        stat->full_cycles[s] = stats->counter(name,
+                                              "Cycles with every entry in use");
+        snprintf(name, sizeof(name), "%s.utilization", occ_names[s]);
+        stats->formula(name, "Average fraction of entries in use",
+                       stat->occupancy[s], NULL, 1.0 / occ_capacity[s]);
+    }
+
+    stat->squashed_iq = stats->counter("iq.squashed",
+                                       "Entries removed by branch flushes");
+    stat->squashed_rob = stats->counter("rob.squashed",
+                                        "Entries removed by branch flushes");
+    stat->squashed_lsq = stats->counter("lsq.squashed",
+                                        "Entries removed by branch flushes");
+
+    stat->btb_lookups = stats->counter("btb.lookups", "Resolved control flow");
+    stat->btb_hits = stats->counter("btb.hits",
+                                    "Resolutions that found a prediction");
+    stat->btb_correct = stats->counter("btb.correct",
+                                       "Hits that predicted the outcome");
+    stat->mispredicts = stats->counter("btb.mispredicts",
+                                       "Redirects that flushed the pipeline");
+    stats->formula("btb.accuracy", "Correct predictions per hit",
+                   stat->btb_correct, stat->btb_hits, 1.0);
+    stats->formula("btb.mpki", "Mispredicts per 1000 retired instructions",
+                   stat->mispredicts, stat->retired, 1000.0);
+
+    for (int fu = 0; fu < 3; fu++) {
+        char name[64];
+        snprintf(name, sizeof(name), "fu.%s.issued", fu_names[fu]);
+        stat->fu_issued[fu] = stats->counter(name, "Operations started");
+        snprintf(name, sizeof(name), "fu.%s.busy_cycles", fu_names[fu]);
+        stat->fu_busy_cycles[fu] = stats->counter(name,
+                                                  "Cycles doing useful work");
+        snprintf(name, sizeof(name), "fu.%s.utilization", fu_names[fu]);
+        stats->formula(name, "Fraction of cycles busy",
+                       stat->fu_busy_cycles[fu], stat->cycles, 1.0);
+    }
+
+    stat->committed = stats->histogram("commit.per_cycle",
+                                       "Instructions retired per cycle",
+                                       apex_config.commit_width + 1, 1);
+    stat->commit_width_limited = stats->counter(
+            "commit.width_limited",
+            "Cycles a completed instruction waited for commit bandwidth");
+
+    stat->urf_free = stats->histogram("urf.free_list",
+                                      "Free registers per cycle",
+                                      URF_SIZE + 1, 1);
+    stat->urf_alloc_failures = stats->counter(
+            "urf.alloc_failures", "Renames that found the free list empty");
+    stat->urf_freed_commit = stats->counter(
+            "urf.freed_at_commit", "Replaced mappings freed when committed");
+    stat->urf_freed_early = stats->counter(
+            "urf.freed_early", "Replaced mappings freed before commit");
+    stat->urf_freed_flush = stats->counter(
+            "urf.freed_by_flush", "Registers of squashed instructions freed");
+
+    stat->elim_copies = stats->counter("rename.eliminated_copies",
+                                       "Register copies mapped to the source");
+    stat->elim_constants = stats->counter("rename.eliminated_constants",
+                                          "MOVCs written at rename");
+    stat->elim_zero_idioms = stats->counter("rename.zero_idioms",
+                                            "SUB/EX-OR of a register with "
+                                            "itself written at rename");
+    stat->elim_shared = stats->counter("rename.shared_registers",
+                                       "Eliminations that reused a register");
+
+    stat->fusion_pairs = stats->counter("fusion.pairs",
+                                        "ADD/SUB/SUBL + BZ/BNZ pairs fused");
+    stat->fusion_missed = stats->counter("fusion.missed",
+                                         "Pairs left unfused for lack of a "
+                                         "CFID");
+    stats->formula("fusion.per_kilo_insn",
+                   "Fused pairs per 1000 retired instructions",
+                   stat->fusion_pairs, stat->retired, 1000.0);
+
+    stat->vp_loads = stats->counter("value_pred.loads",
+                                    "LOADs dispatched with the predictor on");
+    stat->vp_predictions = stats->counter("value_pred.predictions",
+                                          "LOADs that wrote a predicted value");
+    stat->vp_correct = stats->counter("value_pred.correct",
+                                      "Predicted values memFU confirmed");
+    stat->vp_mispredicts = stats->counter("value_pred.mispredicts",
+                                          "Predicted values that squashed "
+                                          "the younger instructions");
+    stats->formula("value_pred.coverage", "Predicted fraction of LOADs",
+                   stat->vp_predictions, stat->vp_loads, 1.0);
+    stats->formula("value_pred.accuracy", "Correct fraction of predictions",
+                   stat->vp_correct, stat->vp_predictions, 1.0);
+
+    stat->early_loads = stats->counter("memdep.early_loads",
+                                       "LOADs that read memory ahead of the "
+                                       "LSQ head");
+    stat->held_loads = stats->counter("memdep.held_loads",
+                                      "LOADs kept behind the STORE of their "
+                                      "store set");
+    stat->violations = stats->counter("memdep.violations",
+                                      "STOREs that found a younger LOAD had "
+                                      "read their address first");
+    stat->violations_avoided = stats->counter("memdep.violations_avoided",
+                                              "Held LOADs whose STORE wrote "
+                                              "their address");
+
+    int sb_size = apex_config.store_buffer;
+    stat->sb_occupancy = stats->histogram("store_buffer.occupancy",
+                                          "Buffered STOREs per cycle",
+                                          sb_size + 1, 1);
+    stat->sb_coalesced = stats->counter("store_buffer.coalesced",
+                                        "STOREs merged into a buffered word");
+    stat->sb_forwarded = stats->counter("store_buffer.forwarded",
+                                        "LOADs served from the buffer");
+    stat->sb_full = stats->counter("store_buffer.full_cycles",
+                                   "Cycles a STORE at the ROB head found "
+                                   "the buffer full");
+
+    if ((apex_config.stats_json || apex_config.stats_csv)
+        && !stats->open(apex_config.stats_json, apex_config.stats_csv))
+        fprintf(stderr, "APEX_CPU : Cannot open statistics output\n");
+}
+
+/*
+ * Start of the region of interest: the registry and the printed tables
+ * forget everything counted so far. Pipeline and predictor state are left
+ * as they are.
+ */
+void APEX_cpu_reset_stats(APEX_CPU *cpu) {
+    cpu->stats->reset();
+    reset_pipeline_stats(cpu);
+}
+
+/*
+ * Opens the region of interest at 'clock', the first cycle it counts.
+ */
+static void roi_begin(APEX_CPU *cpu, int clock) {
+    if (cpu->roi_state != ROI_WARMUP)
+        return;
+    APEX_cpu_reset_stats(cpu);
+    cpu->roi_state = ROI_ACTIVE;
+    cpu->roi_begin_clock = clock;
+    cpu->roi_begin_retired = cpu->ins_completed;
+}
+
+/*
+ * Closes the region of interest before 'clock'. The registry and the
+ * printed tables are frozen, later updates are not counted.
+ */
+static void roi_end(APEX_CPU *cpu, int clock) {
+    if (cpu->roi_state != ROI_ACTIVE)
+        return;
+    cpu->stats->freeze();
+    freeze_pipeline_stats(cpu);
+    cpu->roi_state = ROI_DONE;
+    cpu->roi_end_clock = clock;
+    cpu->roi_end_retired = cpu->ins_completed;
+}
+
+/*
+ * Rebuilds the URF free list after a branch flush. A register keeps one
+ * reference per B-RAT entry mapping it and per surviving in-flight
+ * instruction writing it; the B-RAT reference an early release gave up is
+ * not restored. Anything else, including registers renamed by the
+ * squashed instructions, goes back to the list. Returns the number of
+ * registers freed.
+ */
+static int rebuild_free_list(APEX_CPU *cpu) {
+    vector<int> refs(URF_SIZE, 0);
+    for (int r = 0; r < NUM_ARCH_REGISTERS; r++) {
+        int b = cpu->urf->B_RAT[r];
+        if (b >= 0 && b < URF_SIZE)
+            refs[b]++;
+    }
+    for (int i = 0; i < cpu->window->size(); i++) {
+        DynInstr &instr = cpu->window->entries[i];
+        if (instr.u_rd >= 0 && instr.u_rd < URF_SIZE)
+            refs[instr.u_rd]++;
+        if (instr.prev_released && refs[instr.prev_u_rd] > 0)
+            refs[instr.prev_u_rd]--;
+    }
+    for (int r = 0; r < NUM_ARCH_REGISTERS; r++) {
+        int f = cpu->urf->F_RAT[r];
+        if (f >= 0 && f < URF_SIZE && refs[f] == 0)
+            refs[f] = 1;
+    }
+    return cpu->free_list->rebuild(refs);
+}
+
+/*
+ * Recounts the value predictor's in-flight lookups after a flush: the
+ * LOADs left in the window that have not read memory yet.
+ */
+static void recount_value_pred(APEX_CPU *cpu) {
+    if (!cpu->value_pred)
+        return;
+    vector<int> pcs;
+    for (int i = 0; i < cpu->window->size(); i++) {
+        DynInstr &instr = cpu->window->entries[i];
+        if (instr.complete_clock < 0
+            && cpu->itable[get_code_index(instr.pc)].op == OP_LOAD)
+            pcs.push_back(instr.pc);
+    }
+    cpu->value_pred->recount(pcs);
+}
+
+/*
+ * Points the zero flag rename back at the youngest flag setter left in the
+ * window after a flush, or at the committed zero flag if there is none.
+ */
+static void recover_flag_reg(APEX_CPU *cpu) {
+    cpu->flag_reg = -1;
+    for (int i = cpu->window->size() - 1; i >= 0; i--) {
+        DynInstr &instr = cpu->window->entries[i];
+        if (cpu->itable[get_code_index(instr.pc)].sets_flag) {
+            cpu->flag_reg = instr.u_rd;
+            break;
+        }
+    }
+}
+
 APEX_CPU *
 APEX_cpu_init(const char *filename) {
     if (!filename) {
         return NULL;
     }
 
-    APEX_CPU *cpu = (APEX_CPU *) malloc(sizeof(*cpu));
+    APEX_CPU *cpu = (APEX_CPU *) calloc(1, sizeof(*cpu));
     if (!cpu) {
         return NULL;
     }
 
-    cpu->imap = new map<int, APEX_Instruction *>();
+    /* Pipeline state kept outside APEX_CPU, so several runs can share a process */
+    iMulCycleSpent = 0;
+    memCycleSpent = 0;
+    memEarlyLoad = 0;
+    isHalt = 0;
+    isHaltDecoded = 0;
+
+    /* Inputs are loaded first, so that a bad one fails before any unit is
+     * allocated or any output file is opened */
+    cpu->data_memory = new DataMemory(apex_config.mem_limit,
+                                      apex_config.mem_align);
+    if (apex_config.mem_image) {
+        long words = cpu->data_memory->preload(apex_config.mem_image,
+                                               apex_config.mem_image_base);
+        if (words < 0) {
+            fprintf(stderr, "APEX_CPU : Cannot load memory image %s\n",
+                    apex_config.mem_image);
+            delete cpu->data_memory;
+            free(cpu);
+            return NULL;
+        }
+    }
+
+    /* Load the binary image or parse the input file into code memory */
+    cpu->code_memory = load_program(filename, &cpu->code_memory_size);
+
+    if (!cpu->code_memory) {
+        delete cpu->data_memory;
+        free(cpu);
+        return NULL;
+    }
+
+    cpu->itable = build_instruction_table(cpu->code_memory,
+                                          cpu->code_memory_size);
+    if (!cpu->itable) {
+        fprintf(stderr, "APEX_CPU : Out of memory decoding %s\n", filename);
+        free(cpu->code_memory);
+        delete cpu->data_memory;
+        free(cpu);
+        return NULL;
+    }
 
     /* Initialize IssueQueue */
     cpu->iq = new IQ();
@@ -82,21 +490,78 @@ APEX_cpu_init(const char *filename) {
     /*Initialize BTB*/
     cpu->btb = new BTB();
 
+    /*Initialize in-flight window*/
+    cpu->window = new InstrWindow();
+
+    /*Initialize URF free list, whatever the RATs do not map is free*/
+    cpu->free_list = new FreeList();
+    rebuild_free_list(cpu);
+
+    /*Initialize zero flag rename, no flag setter is in flight*/
+    cpu->flag_reg = -1;
+
+    /*Initialize load value predictor*/
+    cpu->value_pred = NULL;
+    if (apex_config.value_pred != VP_OFF)
+        cpu->value_pred = new ValuePredictor(apex_config.value_pred);
+
+    /*Initialize memory dependence predictor*/
+    cpu->store_sets = NULL;
+    if (apex_config.mem_dep == 1)
+        cpu->store_sets = new StoreSets();
+
+    /*Initialize store buffer*/
+    cpu->store_buffer = NULL;
+    if (apex_config.store_buffer > 0)
+        cpu->store_buffer = new StoreBuffer(apex_config.store_buffer);
+
+    /*Initialize branch, stall, occupancy and lifecycle statistics*/
+    new_pipeline_stats(cpu);
+
+    /*Initialize the statistics registry*/
+    register_stats(cpu);
+
+    /*Initialize Kanata pipeline log*/
+    cpu->kanata = NULL;
+    cpu->next_seq = 0;
+    if (apex_config.kanata_file) {
+        cpu->kanata = new KanataLog();
+        if (!cpu->kanata->open(apex_config.kanata_file, 0)) {
+            fprintf(stderr, "APEX_CPU : Cannot open Kanata log %s\n",
+                    apex_config.kanata_file);
+            delete cpu->kanata;
+            cpu->kanata = NULL;
+        }
+    }
+
     /* Initialize PC, Registers and all pipeline stages */
     cpu->pc = 4000;
     memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES);
-    memset(cpu->data_memory, 0, sizeof(int) * 4000);
-
     memset(&cpu->int_bus, -1, sizeof(Int_Bus));
     memset(&cpu->mem_bus, -1, sizeof(Mem_Bus));
     memset(&cpu->mul_bus, -1, sizeof(Mul_Bus));
 
-    /* Parse input file and create code memory */
-    cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
+    /* Statistics cover the whole run unless a warm-up is marked */
+    cpu->roi_state = ROI_ACTIVE;
+    cpu->roi_end_clock = -1;
+    cpu->roi_end_retired = -1;
+    if (apex_config.warmup_insns > 0 || apex_config.warmup_cycles > 0)
+        cpu->roi_state = ROI_WARMUP;
+    for (int i = 0; i < cpu->code_memory_size; i++) {
+        if (cpu->itable[i].op == OP_ROI_BEGIN)
+            cpu->roi_state = ROI_WARMUP;
+    }
 
-    if (!cpu->code_memory) {
-        free(cpu);
-        return NULL;
+    /* Reference model starts from the same program and memory image */
+    cpu->golden = NULL;
+    if (apex_config.cosim) {
+        DataMemory *golden_memory = new DataMemory(apex_config.mem_limit,
+                                                   apex_config.mem_align);
+        if (apex_config.mem_image)
+            golden_memory->preload(apex_config.mem_image,
+                                   apex_config.mem_image_base);
+        cpu->golden = new GoldenModel(cpu->code_memory, cpu->code_memory_size,
+                                      golden_memory);
     }
 
     if (ENABLE_DEBUG_MESSAGES) {
@@ -166,11 +631,26 @@ void APEX_cpu_stop(APEX_CPU *cpu) {
     delete cpu->lsq;
     delete cpu->rob;
     delete cpu->btb;
-    delete cpu->imap;
+    delete cpu->window;
+    delete cpu->free_list;
+    delete cpu->value_pred;
+    delete cpu->store_sets;
+    delete cpu->store_buffer;
+    delete cpu->branch_stats;
+    delete cpu->stalls;
+    delete cpu->occupancy;
+    delete cpu->lifecycle;
+    delete cpu->profile;
+    delete cpu->stats;
+    delete cpu->kanata;
+    delete cpu->data_memory;
+    delete cpu->golden;
+    free(cpu->itable);
 
     free(cpu->code_memory);
     free(cpu);
-    printf("ALL CLEAR!!");
+    if (ENABLE_DEBUG_MESSAGES)
+        printf("ALL CLEAR!!");
 }
 
 /* Converts the PC(4000 series) into
@@ -194,7 +674,9 @@ static void print_instruction(CPU_Stage *stage, int is_fetch) {
         printf("%s ", stage->opcode);
     }
 
-    if (strcmp(stage->opcode, "NOP") == 0) {
+    if (strcmp(stage->opcode, "NOP") == 0
+        || strcmp(stage->opcode, "ROI_BEGIN") == 0
+        || strcmp(stage->opcode, "ROI_END") == 0) {
         printf("%s ", stage->opcode);
     }
 
@@ -283,6 +765,399 @@ void print_register_status(APEX_CPU *cpu) {
     }
 }
 
+/*
+ * Writes the instruction in the same form print_instruction uses for
+ * Fetch, used as the Kanata label.
+ */
+static void format_instruction(CPU_Stage *stage, char *buf, int size) {
+    const char *op = stage->opcode;
+    if (strcmp(op, "STORE") == 0)
+        snprintf(buf, size, "%d: %s,R%d,R%d,#%d", stage->pc, op, stage->rs1,
+                 stage->rs2, stage->imm);
+    else if (strcmp(op, "BZ") == 0 || strcmp(op, "BNZ") == 0)
+        snprintf(buf, size, "%d: %s,#%d", stage->pc, op, stage->imm);
+    else if (strcmp(op, "JUMP") == 0)
+        snprintf(buf, size, "%d: %s,R%d,#%d", stage->pc, op, stage->rs1,
+                 stage->imm);
+    else if (strcmp(op, "MOVC") == 0)
+        snprintf(buf, size, "%d: %s,R%d,#%d", stage->pc, op, stage->rd,
+                 stage->imm);
+    else if (strcmp(op, "LOAD") == 0 || strcmp(op, "JAL") == 0
+             || strcmp(op, "ADDL") == 0 || strcmp(op, "SUBL") == 0)
+        snprintf(buf, size, "%d: %s,R%d,R%d,#%d", stage->pc, op, stage->rd,
+                 stage->rs1, stage->imm);
+    else if (strcmp(op, "HALT") == 0 || strcmp(op, "NOP") == 0
+             || strcmp(op, "ROI_BEGIN") == 0 || strcmp(op, "ROI_END") == 0)
+        snprintf(buf, size, "%d: %s", stage->pc, op);
+    else
+        snprintf(buf, size, "%d: %s,R%d,R%d,R%d", stage->pc, op, stage->rd,
+                 stage->rs1, stage->rs2);
+}
+
+/*
+ * Reports the instructions sitting in the D/RF and QUEUE latches as having
+ * entered Decode ("Dc") and Dispatch ("Ds"). Called at the start of each
+ * cycle, before any stage has moved.
+ */
+static void trace_latches(APEX_CPU *cpu) {
+    if (!cpu->kanata)
+        return;
+    static const int latches[2] = {DRF, QUEUE};
+    static const char *const names[2] = {"Dc", "Ds"};
+    for (int i = 0; i < 2; i++) {
+        CPU_Stage *stage = &cpu->stage[latches[i]];
+        if (stage->seq > 0 && stage->trace_stage != latches[i]) {
+            cpu->kanata->stage(cpu->clock, stage->seq, names[i]);
+            stage->trace_stage = latches[i];
+        }
+    }
+}
+
+/*
+ * Marks an IQ entry as issued to a function unit. name is the Kanata
+ * stage it enters, "Ag" for LOAD/STORE address generation, else "Ex".
+ */
+static void issue_instr(APEX_CPU *cpu, IQEntry *entry, const char *name) {
+    cpu->window->mark_issued(entry->clock, entry->pc, cpu->clock);
+    cpu->profile->at(entry->pc).issued++;
+    // LOAD/STORE address generation runs on the INT FU
+    cpu->stat.fu_issued[entry->fuType == MUL_FU ? MUL_FU : INT_FU]->inc();
+    if (cpu->kanata) {
+        DynInstr *instr = cpu->window->get(entry->clock, entry->pc);
+        if (instr)
+            cpu->kanata->stage(cpu->clock, instr->seq, name);
+    }
+}
+
+static void complete_instr(APEX_CPU *cpu, DynInstr *instr) {
+    if (cpu->kanata && instr)
+        cpu->kanata->stage(cpu->clock, instr->seq, "Cm");
+    cpu->window->complete(instr, cpu->clock);
+}
+
+/*
+ * Mirrors a successful add_instruction_to_ROB into the in-flight window.
+ * stage_id is the pipeline stage that did the dispatch this cycle, src1
+ * and src2 are the URF registers the instruction reads (-1 if none).
+ */
+static void track_dispatch(APEX_CPU *cpu, CPU_Stage *stage, int stage_id,
+                           int u_rd, int src1, int src2, int is_mem,
+                           int issued) {
+    DynInstr instr;
+    instr.seq = stage->seq;
+    instr.pc = stage->pc;
+    strcpy(instr.opcode, stage->opcode);
+    if (cpu->itable[get_code_index(stage->pc)].writes_rd) {
+        instr.u_rd = u_rd;
+        instr.prev_u_rd = stage->prev_u_rd;
+    }
+    instr.src1 = src1;
+    instr.src2 = src2;
+    instr.fused_cfid = stage->fused_cfid;
+    instr.src1_pending = src1 >= 0 && !cpu->urf->URF_TABLE_valid[src1];
+    instr.src2_pending = src2 >= 0 && !cpu->urf->URF_TABLE_valid[src2];
+    instr.is_mem = is_mem;
+    instr.issued = issued;
+    instr.fetch_clock = stage->fetch_clock;
+    instr.rename_clock = stage->rename_clock;
+    instr.dispatch_clock = cpu->clock;
+
+    if (cpu->kanata) {
+        cpu->kanata->stage(cpu->clock, instr.seq, "Iq");
+        int srcs[2] = {src1, src2};
+        int pending[2] = {instr.src1_pending, instr.src2_pending};
+        for (int i = 0; i < 2; i++) {
+            if (pending[i] && srcs[i] < (int) cpu->window->last_writer.size())
+                cpu->kanata->dependency(cpu->clock, instr.seq,
+                                        cpu->window->last_writer[srcs[i]].seq);
+        }
+    }
+    cpu->window->dispatch(instr);
+
+    cpu->branch_stats->note_dispatch(cpu->clock);
+    cpu->stalls->set(stage_id, STALL_NONE);
+}
+
+/*
+ * Retires the oldest instruction from the in-flight window, mirrors
+ * retire_instruction_from_ROB.
+ */
+static void retire_from_window(APEX_CPU *cpu) {
+    if (cpu->window->size() > 0) {
+        DynInstr &instr = cpu->window->entries.front();
+        instr.retire_clock = cpu->clock;
+        cpu->lifecycle->record(instr);
+        cpu->profile->at(instr.pc).retired++;
+        cpu->stat.retired->inc();
+        if (cpu->kanata)
+            cpu->kanata->retire(cpu->clock, instr.seq);
+    }
+    cpu->window->retire();
+}
+
+/*
+ * Records the outcome of a resolved control flow instruction and trains
+ * the BTB with it.
+ */
+static void record_branch_outcome(APEX_CPU *cpu, IQEntry *branch, int taken) {
+    int prediction = cpu->btb->get_last_prediction(branch->pc);
+    cpu->branch_stats->record_resolution(branch->pc, branch->opcode, taken,
+                                         prediction);
+    cpu->stat.btb_lookups->inc();
+    if (prediction != GARBAGE) {
+        cpu->stat.btb_hits->inc();
+        if (prediction == taken)
+            cpu->stat.btb_correct->inc();
+    }
+    cpu->btb->update_prediction(branch->CFID, branch->pc, taken);
+}
+
+/*
+ * Counts what a flush of everything younger than window entry 'index'
+ * throws away, drops it from the window and returns the number of ROB
+ * entries. Must be called before the D/RF and QUEUE latches are cleared.
+ */
+static int record_squash(APEX_CPU *cpu, int index, int *iq_count,
+                         int *lsq_count, int *frontend) {
+    *frontend = 0;
+    if (strlen(cpu->stage[DRF].opcode) > 0)
+        (*frontend)++;
+    if (strlen(cpu->stage[QUEUE].opcode) > 0)
+        (*frontend)++;
+
+    // A latch may still hold a copy of an older, already dispatched
+    // instruction; only what never reached the window is squashed there
+    int latches[2] = {DRF, QUEUE};
+    bool dispatched[2];
+    for (int i = 0; i < 2; i++) {
+        int seq = cpu->stage[latches[i]].seq;
+        dispatched[i] = seq <= 0;
+        for (int j = 0; j < cpu->window->size(); j++)
+            dispatched[i] = dispatched[i] || cpu->window->entries[j].seq == seq;
+        if (!dispatched[i])
+            cpu->profile->at(cpu->stage[latches[i]].pc).squashed++;
+    }
+
+    for (int i = index >= 0 ? index + 1 : cpu->window->size();
+         i < cpu->window->size(); i++)
+        cpu->profile->at(cpu->window->entries[i].pc).squashed++;
+    int rob_count = cpu->window->squash_younger(index, iq_count, lsq_count);
+    cpu->stat.squashed_rob->inc(rob_count);
+    cpu->stat.squashed_iq->inc(*iq_count);
+    cpu->stat.squashed_lsq->inc(*lsq_count);
+
+    if (cpu->kanata) {
+        for (int i = 0; i < (int) cpu->window->squashed.size(); i++)
+            cpu->kanata->flush(cpu->clock, cpu->window->squashed[i]);
+        for (int i = 0; i < 2; i++) {
+            if (!dispatched[i])
+                cpu->kanata->flush(cpu->clock, cpu->stage[latches[i]].seq);
+        }
+    }
+    return rob_count;
+}
+
+/*
+ * Counts what a branch flush throws away. Must be called before the D/RF
+ * and QUEUE latches are cleared.
+ */
+static void record_branch_flush(APEX_CPU *cpu, IQEntry *branch) {
+    int iq_count, lsq_count, frontend;
+    int index = cpu->window->find(branch->clock, branch->pc);
+    int rob_count = record_squash(cpu, index, &iq_count, &lsq_count,
+                                  &frontend);
+    cpu->branch_stats->record_flush(branch->pc, cpu->clock, rob_count,
+                                    iq_count, lsq_count, frontend);
+    cpu->stat.mispredicts->inc();
+}
+
+/*
+ * Squashes everything younger than a taken control flow instruction: the
+ * D/RF and QUEUE latches, the ROB, IQ and LSQ entries of its CFID and the
+ * later ones, and the renames its snapshot does not cover. Fetch is held
+ * for a cycle if stall_fetch is set (JAL redirects it without a bubble).
+ * The caller points cpu->pc at the target.
+ */
+static void squash_after_branch(APEX_CPU *cpu, IQEntry *branch,
+                                int stall_fetch) {
+    CPU_Stage *drf_stage = &cpu->stage[DRF];
+    CPU_Stage *queue_stage = &cpu->stage[QUEUE];
+    int tempSID = cpu->rob->get_slot_id_from_cfid(branch->CFID, branch->pc);
+    Rob_entry *thisEntry = &cpu->rob->rob_queue[tempSID];
+
+    record_branch_flush(cpu, branch);
+    memset(drf_stage, 0, sizeof(CPU_Stage));
+    memset(queue_stage, 0, sizeof(CPU_Stage));
+    drf_stage->stalled = 1;
+    queue_stage->stalled = 1;
+    isHaltDecoded = 0;
+    if (stall_fetch)
+        cpu->stage[F].stalled = 1;
+    //FLUSH ROB
+    cpu->rob->flush_ROB_entries(tempSID, cpu);
+    //FLUSH not only IQ but also LSQ
+    deque<int> cfidDeque = cpu->btb->CF_instn_order;
+    deque<int>::iterator itr;
+    itr = find(cfidDeque.begin(), cfidDeque.end(), branch->CFID);
+    for (; itr != cfidDeque.end(); itr++) {
+        int tempCFID = *itr;
+        cpu->iq->flushIQEntries(tempCFID, branch->pc);
+        cpu->lsq->flushLSQEntries(tempCFID);
+    }
+
+    //Restoring Snapshot
+    URF_data *temp;
+    temp = (URF_data *) thisEntry->getPv_saved_info();
+    cpu->urf->restoreSnapshot(*temp);
+    cpu->stat.urf_freed_flush->inc(rebuild_free_list(cpu));
+    recover_flag_reg(cpu);
+    recount_value_pred(cpu);
+}
+
+/*
+ * Replays everything younger than the LOAD/STORE memFU just finished at
+ * the ROB head: a LOAD whose predicted value was wrong, or a STORE a
+ * younger LOAD read ahead of. The rest of the ROB, IQ and LSQ goes, the
+ * F-RAT falls back to the B-RAT plus the LOAD's own mapping (u_rd, -1 for
+ * a STORE), and fetch restarts after it.
+ */
+static void squash_after_mem(APEX_CPU *cpu, int pc, int cfid, int u_rd) {
+    CPU_Stage *drf_stage = &cpu->stage[DRF];
+    CPU_Stage *queue_stage = &cpu->stage[QUEUE];
+    int tempSID = cpu->rob->get_slot_id_from_cfid(cfid, pc);
+
+    int iq_count, lsq_count, frontend;
+    record_squash(cpu, 0, &iq_count, &lsq_count, &frontend);
+    memset(drf_stage, 0, sizeof(CPU_Stage));
+    memset(queue_stage, 0, sizeof(CPU_Stage));
+    drf_stage->stalled = 1;
+    queue_stage->stalled = 1;
+    isHaltDecoded = 0;
+    cpu->stage[F].stalled = 1;
+    // A MUL in flight is younger too
+    memset(&cpu->stage[MUL_EX], 0, sizeof(CPU_Stage));
+    iMulCycleSpent = 0;
+    cpu->int_bus.r = -1;
+    cpu->mul_bus.r = -1;
+
+    // Every unresolved control flow instruction is younger
+    deque<int> cfidDeque = cpu->btb->CF_instn_order;
+    cpu->rob->flush_ROB_entries(tempSID, cpu);
+    cpu->iq->flushIQEntries(cfid, pc);
+    cpu->lsq->flushLSQEntries(cfid);
+    for (deque<int>::iterator itr = cfidDeque.begin(); itr != cfidDeque.end();
+         itr++) {
+        cpu->iq->flushIQEntries(*itr, pc);
+        cpu->lsq->flushLSQEntries(*itr);
+    }
+
+    for (int r = 0; r < NUM_ARCH_REGISTERS; r++)
+        cpu->urf->F_RAT[r] = cpu->urf->B_RAT[r];
+    if (u_rd >= 0)
+        cpu->urf->F_RAT[cpu->code_memory[get_code_index(pc)].rd] = u_rd;
+    cpu->stat.urf_freed_flush->inc(rebuild_free_list(cpu));
+    recover_flag_reg(cpu);
+    recount_value_pred(cpu);
+    cpu->pc = pc + 4;
+}
+
+/*
+ * Memory as a LOAD sees it: the buffered value of the word if a committed
+ * STORE to it has not been written yet.
+ */
+static int peek_memory(APEX_CPU *cpu, int address) {
+    int value;
+    if (cpu->store_buffer && cpu->store_buffer->forward(address, &value))
+        return value;
+    return cpu->data_memory->peek(address);
+}
+
+/*
+ * Writes the oldest buffered STORE to data memory once it has spent
+ * STORE_DRAIN_CYCLES cycles on it, or every STORE if 'all' is set. A
+ * faulting write stops the machine.
+ */
+static void drain_store_buffer(APEX_CPU *cpu, int all) {
+    StoreBuffer *sb = cpu->store_buffer;
+    if (!sb)
+        return;
+    while (!sb->entries.empty()) {
+        if (!all && ++sb->drain_cycles < STORE_DRAIN_CYCLES)
+            return;
+        SB_Entry &entry = sb->entries.front();
+        if (!cpu->data_memory->write(entry.pc, entry.address, entry.value))
+            isHalt = TRUE;
+        sb->entries.pop_front();
+        sb->drain_cycles = 0;
+        if (!all)
+            return;
+    }
+}
+
+/*
+ * Prints a co-simulation divergence and stops the run.
+ */
+static void report_divergence(APEX_CPU *cpu, int pc, const char *what,
+                              int expected, int actual) {
+    printf("\nAPEX_CPU : Co-simulation divergence at clock %d, commit %ld, "
+           "pc(%d) %s: %s expected %d, got %d\n", cpu->clock,
+           cpu->golden->committed, pc,
+           cpu->code_memory[get_code_index(pc)].opcode, what, expected,
+           actual);
+    delete cpu->golden;
+    cpu->golden = NULL;
+    isHalt = TRUE;
+}
+
+/*
+ * Steps the golden model past the instruction committing at pc and checks
+ * what the pipeline made architecturally visible: the destination
+ * register through the B-RAT, the zero flag of arithmetic instructions and,
+ * for a STORE, the address written (mem_address) and the stored word.
+ * Only the committing instruction's own effects are compared, so the
+ * check costs a handful of loads per commit.
+ */
+static void cosim_commit(APEX_CPU *cpu, int pc, int mem_address) {
+    if (!cpu->golden)
+        return;
+
+    int expected_pc = cpu->golden->pc;
+    GoldenResult result;
+    if (!cpu->golden->step(&result) || result.pc != pc) {
+        report_divergence(cpu, pc, "committed pc", expected_pc, pc);
+        return;
+    }
+
+    if (result.rd >= 0) {
+        int reg = cpu->urf->B_RAT[result.rd];
+        int actual = reg >= 0 ? cpu->urf->URF_Table[reg] : 0;
+        if (actual != result.rd_value) {
+            char what[32];
+            sprintf(what, "R%d", result.rd);
+            report_divergence(cpu, pc, what, result.rd_value, actual);
+            return;
+        }
+    }
+
+    if (result.sets_flag && cpu->zero_flag != result.zero_flag) {
+        report_divergence(cpu, pc, "zero flag", result.zero_flag,
+                          cpu->zero_flag);
+        return;
+    }
+
+    if (result.op == OP_STORE) {
+        if (mem_address != result.mem_address) {
+            report_divergence(cpu, pc, "store address", result.mem_address,
+                              mem_address);
+            return;
+        }
+        int actual = peek_memory(cpu, mem_address);
+        if (actual != result.store_value)
+            report_divergence(cpu, pc, "stored value", result.store_value,
+                              actual);
+    }
+}
+
 /*
  *  Fetch Stage of APEX Pipeline
  *
@@ -295,6 +1170,7 @@ int fetch(APEX_CPU *cpu) {
     if (!stage->busy && !stage->stalled) {
         /* Store current PC in fetch latch */
         stage->pc = cpu->pc;
+        stage->fetch_clock = cpu->clock;
 
 
         int MaxCodeSize = 4000 + (4 * cpu->code_memory_size);
@@ -312,28 +1188,56 @@ int fetch(APEX_CPU *cpu) {
         stage->rs2 = current_ins->rs2;
         stage->imm = current_ins->imm;
 
-        cpu->imap->insert(make_pair(cpu->pc, current_ins));
-
         /* Update PC for next instruction */
         if (!drf_stage->stalled) {
             cpu->pc += 4;
+            cpu->profile->at(stage->pc).fetched++;
+            stage->seq = ++cpu->next_seq;
+            stage->trace_stage = F;
+            if (cpu->kanata) {
+                char label[64];
+                format_instruction(stage, label, sizeof(label));
+                cpu->kanata->fetch(cpu->clock, stage->seq, label);
+            }
             cpu->stage[DRF] = cpu->stage[F];
+            cpu->stalls->set(F, STALL_NONE);
             if (ENABLE_DEBUG_MESSAGES) {
                 print_stage_content("Fetch", stage);
             }
             return 0;
         } else {
             stage->stalled = 1;
-
+            // Charge fetch with whatever is holding D/RF
+            cpu->stalls->set(F, cpu->stalls->get(DRF));
         }
+    } else if (stage->stalled) {
+        cpu->stalls->set(F, STALL_FLUSH);
     }
     return 0;
 }
 
+/*
+ * Takes a register off the free list for the destination of the
+ * instruction in D/RF and remembers the F-RAT mapping it replaces. A flag
+ * setter renames the zero flag to the same register. Returns -1 if the
+ * free list is empty.
+ */
+static int rename_destination(APEX_CPU *cpu, CPU_Stage *stage) {
+    int reg = cpu->free_list->allocate();
+    if (reg == -1) {
+        cpu->stat.urf_alloc_failures->inc();
+        return -1;
+    }
+    stage->prev_u_rd = cpu->urf->F_RAT[stage->rd];
+    if (cpu->itable[get_code_index(stage->pc)].sets_flag)
+        cpu->flag_reg = reg;
+    return reg;
+}
+
 int renamer(APEX_CPU *cpu) {
     CPU_Stage *stage = &cpu->stage[DRF];
     if (strcmp(stage->opcode, "MOVC") == 0) {
-        int urfRd = cpu->urf->get_next_free_register();
+        int urfRd = rename_destination(cpu, stage);
         if (urfRd != -1) {
             stage->u_rd = urfRd;
             //Mark destination register invalid
@@ -357,7 +1261,7 @@ int renamer(APEX_CPU *cpu) {
         || strcmp(stage->opcode, "OR") == 0
         || strcmp(stage->opcode, "EX-OR") == 0
         || strcmp(stage->opcode, "MUL") == 0) {
-        int urfRd = cpu->urf->get_next_free_register();
+        int urfRd = rename_destination(cpu, stage);
         if (urfRd != -1) {
             stage->u_rd = urfRd;
 
@@ -377,7 +1281,7 @@ int renamer(APEX_CPU *cpu) {
 
     if (strcmp(stage->opcode, "ADDL") == 0
         || strcmp(stage->opcode, "SUBL") == 0) {
-        int urfRd = cpu->urf->get_next_free_register();
+        int urfRd = rename_destination(cpu, stage);
         if (urfRd != -1) {
             stage->u_rd = urfRd;
 
@@ -402,7 +1306,7 @@ int renamer(APEX_CPU *cpu) {
     }
 
     if (strcmp(stage->opcode, "LOAD") == 0 || strcmp(stage->opcode, "JAL") == 0) {
-        int urfRd = cpu->urf->get_next_free_register();
+        int urfRd = rename_destination(cpu, stage);
         if (urfRd != -1) {
             stage->u_rd = urfRd;
 
@@ -418,30 +1322,298 @@ int renamer(APEX_CPU *cpu) {
     return 0;
 }
 
+/*
+ * Macro-op fusion (--fusion=1): an ADD, SUB or SUBL leaving D/RF takes the
+ * BZ/BNZ that follows it along, as if both had been fetched together. The
+ * branch gets its CFID here and its ROB entry at dispatch, but no IQ
+ * entry: it resolves from the arithmetic's result in the same INT FU
+ * operation.
+ */
+static void fuse_branch(APEX_CPU *cpu, CPU_Stage *stage) {
+    int op = cpu->itable[get_code_index(stage->pc)].op;
+    if (!apex_config.fusion
+        || (op != OP_ADD && op != OP_SUB && op != OP_SUBL))
+        return;
+    int next = stage->pc + 4;
+    if (cpu->pc != next || get_code_index(next) >= cpu->code_memory_size)
+        return;
+    APEX_Instruction *code = &cpu->code_memory[get_code_index(next)];
+    if (code->op != OP_BZ && code->op != OP_BNZ)
+        return;
+
+    int cfid = cpu->btb->get_next_free_CFID();
+    if (cfid == -1) {
+        cpu->stat.fusion_missed->inc();
+        return;
+    }
+    cpu->btb->add_cfid(cfid);
+    stage->fused_cfid = cfid;
+    stage->fused_seq = ++cpu->next_seq;
+    cpu->stat.fusion_pairs->inc();
+
+    // Fetch moves on past the branch
+    cpu->pc += 4;
+    cpu->profile->at(next).fetched++;
+    if (cpu->kanata) {
+        CPU_Stage branch;
+        memset(&branch, 0, sizeof(CPU_Stage));
+        branch.pc = next;
+        strcpy(branch.opcode, code->opcode);
+        branch.imm = code->imm;
+        char label[64];
+        format_instruction(&branch, label, sizeof(label));
+        cpu->kanata->fetch(cpu->clock, stage->fused_seq, label);
+    }
+}
+
+/*
+ * Drops a bus value of a register written outside a function unit; the
+ * bus may still carry its previous value, which the comparators prefer.
+ */
+static void clear_stale_bus(APEX_CPU *cpu, int reg) {
+    if (cpu->int_bus.r == reg)
+        cpu->int_bus.r = -1;
+    if (cpu->mul_bus.r == reg)
+        cpu->mul_bus.r = -1;
+    if (cpu->mem_bus.r == reg)
+        cpu->mem_bus.r = -1;
+}
+
+/*
+ * Move elimination (--move-elim=1) for the instruction in D/RF. Constants
+ * (MOVC, and SUB/EX-OR of a register with itself, which always give 0)
+ * get a URF register written here, shared with any live register already
+ * holding the same value. Copies (ADDL/SUBL #0, AND/OR of a register with
+ * itself) map rd to the source register once its value is known, which
+ * the zero flag they set needs. Either way the instruction enters the ROB
+ * complete and never uses the IQ or a function unit.
+ *
+ * Returns 1 if the instruction was eliminated, 0 if it takes the normal
+ * path and -1 if the ROB is full.
+ */
+static int eliminate_move(APEX_CPU *cpu, CPU_Stage *stage) {
+    if (strlen(stage->opcode) == 0)
+        return 0;
+
+    int op = cpu->itable[get_code_index(stage->pc)].op;
+    int reg = -1, value, flag = -1;
+    Stat *kind;
+    if (op == OP_MOVC) {
+        value = stage->imm;
+        kind = cpu->stat.elim_constants;
+    } else if ((op == OP_SUB || op == OP_EXOR) && stage->rs1 == stage->rs2) {
+        value = 0;
+        flag = 1;
+        kind = cpu->stat.elim_zero_idioms;
+    } else if (((op == OP_ADDL || op == OP_SUBL) && stage->imm == 0)
+               || ((op == OP_AND || op == OP_OR) && stage->rs1 == stage->rs2)) {
+        reg = cpu->urf->F_RAT[stage->rs1];
+        if (reg < 0 || !cpu->urf->URF_TABLE_valid[reg])
+            return 0;
+        value = cpu->urf->URF_Table[reg];
+        flag = value == 0;
+        kind = cpu->stat.elim_copies;
+    } else {
+        return 0;
+    }
+
+    if (cpu->window->size() >= ROB_SIZE)
+        return -1;
+    if (reg < 0)
+        reg = cpu->free_list->find_constant(value);
+    if (reg >= 0) {
+        cpu->free_list->share(reg);
+        cpu->stat.elim_shared->inc();
+    } else {
+        reg = cpu->free_list->allocate();
+        if (reg == -1)
+            return 0;
+        cpu->urf->URF_Table[reg] = value;
+        cpu->urf->URF_TABLE_valid[reg] = 1;
+        cpu->free_list->set_constant(reg, value);
+        clear_stale_bus(cpu, reg);
+    }
+
+    stage->CFID = cpu->btb->last_control_flow_instr;
+    Rob_entry rob_entry;
+    rob_entry.setStatus(VALID);
+    rob_entry.setPc_value(stage->pc);
+    rob_entry.setExcodes(flag);
+    rob_entry.setResult(value);
+    rob_entry.setArchiteture_register(stage->rd);
+    rob_entry.setM_unifier_register(reg);
+    rob_entry.setCFID(stage->CFID);
+    if (!cpu->rob->add_instruction_to_ROB(rob_entry)) {
+        cpu->free_list->release(reg);
+        return -1;
+    }
+
+    stage->u_rd = reg;
+    stage->prev_u_rd = cpu->urf->F_RAT[stage->rd];
+    cpu->urf->F_RAT[stage->rd] = reg;
+    if (flag != -1) {
+        cpu->urf->URF_Z[reg] = flag;
+        cpu->flag_reg = reg;
+    }
+    track_dispatch(cpu, stage, DRF, reg, -1, -1, 0, 1);
+    complete_instr(cpu, &cpu->window->entries.back());
+    kind->inc();
+    return 1;
+}
+
+/*
+ * Samples how many entries of each queue and register pool are in use at
+ * the end of a cycle. A URF register is in use while it is off the free
+ * list.
+ */
+static void sample_occupancy(APEX_CPU *cpu) {
+    int iq_count = 0;
+    for (int i = 0; i < IQ_SIZE; i++) {
+        if (cpu->iq->issueQueue[i].allocated != UNALLOCATED)
+            iq_count++;
+    }
+
+    int lsq_count = 0;
+    for (int i = 0; i < cpu->window->size(); i++) {
+        if (cpu->window->entries[i].is_mem)
+            lsq_count++;
+    }
+    int urf_count = URF_SIZE - cpu->free_list->count();
+    cpu->stat.urf_free->sample(cpu->free_list->count());
+    if (cpu->store_buffer)
+        cpu->stat.sb_occupancy->sample(cpu->store_buffer->count());
+
+    int counts[NUM_OCC_STRUCTURES];
+    counts[OCC_IQ] = iq_count;
+    counts[OCC_ROB] = cpu->window->size();
+    counts[OCC_LSQ] = lsq_count;
+    counts[OCC_URF] = urf_count;
+    counts[OCC_CFID] = CFID_SIZE - (int) cpu->btb->free_CFID_list.size();
+    for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+        cpu->occupancy->sample(s, counts[s]);
+        cpu->stat.occupancy[s]->sample(counts[s]);
+        if (counts[s] >= cpu->occupancy->records[s].capacity)
+            cpu->stat.full_cycles[s]->inc();
+    }
+}
+
+/*
+ * Per-cycle registry updates, called before the stall classification of
+ * the cycle is closed. Opens and closes a command line region of interest
+ * and writes a snapshot every --stats-interval cycles.
+ */
+static void count_cycle(APEX_CPU *cpu) {
+    static const int fu_stages[3] = {INT_EX, MUL_EX, MEM_EX};
+    cpu->stat.cycles->inc();
+    if (cpu->window->size() > 0
+        && cpu->window->entries.front().complete_clock < 0)
+        cpu->profile->at(cpu->window->entries.front().pc).head_stall_cycles++;
+    for (int fu = 0; fu < 3; fu++) {
+        if (cpu->stalls->get(fu_stages[fu]) == STALL_NONE)
+            cpu->stat.fu_busy_cycles[fu]->inc();
+    }
+
+    // Command line region of interest, from the next cycle on
+    if (cpu->roi_state == ROI_WARMUP
+        && ((apex_config.warmup_cycles > 0
+             && cpu->clock + 1 >= apex_config.warmup_cycles)
+            || (apex_config.warmup_insns > 0
+                && cpu->ins_completed >= apex_config.warmup_insns)))
+        roi_begin(cpu, cpu->clock + 1);
+    else if (cpu->roi_state == ROI_ACTIVE && apex_config.roi_insns > 0
+             && cpu->ins_completed - cpu->roi_begin_retired
+                >= apex_config.roi_insns)
+        roi_end(cpu, cpu->clock + 1);
+
+    if (apex_config.stats_interval > 0
+        && (cpu->clock + 1) % apex_config.stats_interval == 0)
+        cpu->stats->dump(cpu->clock + 1);
+}
+
+/*
+ * Holds the instruction in its latch for this cycle and records why.
+ * The stalled flag is cleared again by intFU at the start of the next cycle.
+ */
+static int stall_stage(APEX_CPU *cpu, CPU_Stage *stage, int stage_id,
+                       int reason) {
+    stage->stalled = 1;
+    cpu->stalls->set(stage_id, reason);
+    return 0;
+}
+
 /*
  *  Decode Stage of APEX Pipeline
  */
 int decode(APEX_CPU *cpu) {
     CPU_Stage *stage = &cpu->stage[DRF];
+    CPU_Stage *queue_stage = &cpu->stage[QUEUE];
 
     // as per specification, HALT stalls the D/RF stage and adds entry in ROB. No entry in IQ is needed
     if (strcmp(stage->opcode, "HALT") == 0) {
-
-        stage->CFID = cpu->btb->last_control_flow_instr;
-        Rob_entry rob_entry;
-        rob_entry.setPc_value(stage->pc);
-        rob_entry.setCFID(stage->CFID);
-        if (cpu->rob->add_instruction_to_ROB(rob_entry)) {      // Adding to ROB
-//			cout << "HALT is  added to ROB" << endl;
-            memset(stage, 0, sizeof(CPU_Stage));
+        if (queue_stage->stalled)
+            return stall_stage(cpu, stage, DRF, cpu->stalls->get(QUEUE));
+
+        if (!isHaltDecoded) {
+            stage->CFID = cpu->btb->last_control_flow_instr;
+            Rob_entry rob_entry;
+            rob_entry.setPc_value(stage->pc);
+            rob_entry.setCFID(stage->CFID);
+            if (cpu->rob->add_instruction_to_ROB(rob_entry)) {      // Adding to ROB
+//			    cout << "HALT is  added to ROB" << endl;
+                stage->rename_clock = cpu->clock;
+                track_dispatch(cpu, stage, DRF, -1, -1, -1, 0, 1);
+                complete_instr(cpu, &cpu->window->entries.back());
+                isHaltDecoded = TRUE;
+            } else
+                return stall_stage(cpu, stage, DRF, STALL_ROB_FULL);
         }
+        // HALT stays in D/RF, holding fetch, until it retires or is flushed
         if (ENABLE_DEBUG_MESSAGES)
             print_stage_content("Decode/RF", stage);
-        return 0;
+        return stall_stage(cpu, stage, DRF, STALL_HALT);
     }
 
     if (!stage->busy && !stage->stalled) {
 
+        /* QUEUE latch still holds an instruction addToQueues could not dispatch */
+        if (queue_stage->stalled && strlen(stage->opcode) > 0)
+            return stall_stage(cpu, stage, DRF, cpu->stalls->get(QUEUE));
+
+        // Only kept if the instruction leaves D/RF this cycle
+        stage->rename_clock = cpu->clock;
+
+        /* ROI markers go straight to the ROB, already complete, and take
+         * effect when they retire */
+        if (strcmp(stage->opcode, "ROI_BEGIN") == 0
+            || strcmp(stage->opcode, "ROI_END") == 0) {
+            stage->CFID = cpu->btb->last_control_flow_instr;
+            Rob_entry rob_entry;
+            rob_entry.setPc_value(stage->pc);
+            rob_entry.setExcodes(-1);
+            rob_entry.setCFID(stage->CFID);
+            if (!cpu->rob->add_instruction_to_ROB(rob_entry))
+                return stall_stage(cpu, stage, DRF, STALL_ROB_FULL);
+            track_dispatch(cpu, stage, DRF, -1, -1, -1, 0, 1);
+            complete_instr(cpu, &cpu->window->entries.back());
+            if (ENABLE_DEBUG_MESSAGES)
+                print_stage_content("Decode/RF", stage);
+            memset(stage, 0, sizeof(CPU_Stage));
+            return 0;
+        }
+
+        /* Eliminated moves, constants and zero idioms are complete at rename */
+        if (apex_config.move_elim) {
+            int eliminated = eliminate_move(cpu, stage);
+            if (eliminated < 0)
+                return stall_stage(cpu, stage, DRF, STALL_ROB_FULL);
+            if (eliminated > 0) {
+                if (ENABLE_DEBUG_MESSAGES)
+                    print_stage_content("Decode/RF", stage);
+                memset(stage, 0, sizeof(CPU_Stage));
+                return 0;
+            }
+        }
+
         /* No Register file read needed for MOVC */
         if (strcmp(stage->opcode, "MOVC") == 0) {
             stage->fuType = INT_FU;
@@ -449,11 +1621,13 @@ int decode(APEX_CPU *cpu) {
                 // Go to next stage
                 stage->CFID = cpu->btb->last_control_flow_instr;;
                 cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
                 if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("Decode/RF", stage);
                 memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_URF);
         }
 
         if (strcmp(stage->opcode, "JUMP") == 0) {
@@ -465,28 +1639,35 @@ int decode(APEX_CPU *cpu) {
                     cpu->btb->add_cfid(cfid);
                     cpu->stage[QUEUE] = cpu->stage[DRF];
                     stage->rs1_value = comparator_rs1(cpu, stage);
+                    cpu->stalls->set(DRF, STALL_NONE);
                     if (ENABLE_DEBUG_MESSAGES)
                         print_stage_content("Decode/RF", stage);
                     memset(stage, 0, sizeof(CPU_Stage));
                     return 0;
                 }
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_CFID);
         }
 
         if (strcmp(stage->opcode, "JAL") == 0) {
             stage->fuType = INT_FU;
+            // Check for a CFID first so a failed attempt does not leak a URF register
+            if (cpu->btb->free_CFID_list.empty())
+                return stall_stage(cpu, stage, DRF, STALL_NO_CFID);
             if (renamer(cpu) == 1) {
                 int cfid = cpu->btb->get_next_free_CFID();
-                if (cfid != -1) {
-                    stage->rs1_value = comparator_rs1(cpu, stage);
-                    cpu->stage[QUEUE] = cpu->stage[DRF];
+                stage->CFID = cfid;
+                cpu->btb->add_cfid(cfid);
+                stage->rs1_value = comparator_rs1(cpu, stage);
+                cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
 
-                    if (ENABLE_DEBUG_MESSAGES)
-                        print_stage_content("Decode/RF", stage);
-                    memset(stage, 0, sizeof(CPU_Stage));
-                    return 0;
-                }
+                if (ENABLE_DEBUG_MESSAGES)
+                    print_stage_content("Decode/RF", stage);
+                memset(stage, 0, sizeof(CPU_Stage));
+                return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_URF);
         }
 
 
@@ -497,12 +1678,16 @@ int decode(APEX_CPU *cpu) {
             if (cfid != -1) {
                 stage->CFID = cfid;
                 cpu->btb->add_cfid(cfid);
+                // The renamed zero flag is the branch's source operand
+                stage->u_rs1 = cpu->flag_reg;
                 cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
                 if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("Decode/RF", stage);
                 memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_CFID);
         }
 
         if (strcmp(stage->opcode, "ADD") == 0
@@ -519,15 +1704,18 @@ int decode(APEX_CPU *cpu) {
                 stage->rs1_value = comparator_rs1(cpu, stage);
                 stage->rs2_value = comparator_rs2(cpu, stage);
                 stage->CFID = cpu->btb->last_control_flow_instr;
+                fuse_branch(cpu, stage);
                 // Go to next
 
                 cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
 
                 if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("Decode/RF", stage);
                 memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_URF);
         }
 
         if (strcmp(stage->opcode, "ADDL") == 0
@@ -536,12 +1724,15 @@ int decode(APEX_CPU *cpu) {
             if (renamer(cpu) == 1) {
                 stage->rs1_value = comparator_rs1(cpu, stage);
                 stage->CFID = cpu->btb->last_control_flow_instr;
+                fuse_branch(cpu, stage);
                 cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
                 if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("Decode/RF", stage);
                 memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_URF);
         }
 
         if (strcmp(stage->opcode, "MUL") == 0) {
@@ -554,11 +1745,13 @@ int decode(APEX_CPU *cpu) {
                 // Go to next stage
                 stage->CFID = cpu->btb->last_control_flow_instr;
                 cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
                 if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("Decode/RF", stage);
                 memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_URF);
         }
 
         if (strcmp(stage->opcode, "STORE") == 0) {
@@ -570,11 +1763,13 @@ int decode(APEX_CPU *cpu) {
                 // Go to next stage
                 stage->CFID = cpu->btb->last_control_flow_instr;
                 cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
                 if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("Decode/RF", stage);
                 memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_URF);
         }
 
         if (strcmp(stage->opcode, "LOAD") == 0) {
@@ -585,26 +1780,128 @@ int decode(APEX_CPU *cpu) {
                 // Go to next stage
                 stage->CFID = cpu->btb->last_control_flow_instr;
                 cpu->stage[QUEUE] = cpu->stage[DRF];
+                cpu->stalls->set(DRF, STALL_NONE);
                 if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("Decode/RF", stage);
                 memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
+            return stall_stage(cpu, stage, DRF, STALL_NO_URF);
         }
 
+    } else if (stage->stalled) {
+        cpu->stalls->set(DRF, STALL_FLUSH);
     }
 
     return 0;
 }
 
+/*
+ * Checks ROB and IQ capacity before anything is allocated, so that a
+ * dispatch which cannot complete leaves no partial IQ/LSQ/ROB entries
+ * behind and can simply be retried next cycle.
+ */
+static int dispatch_blocked(APEX_CPU *cpu) {
+    // A fused branch takes a second ROB entry
+    int needed = cpu->stage[QUEUE].fused_cfid ? 2 : 1;
+    if (cpu->window->size() + needed > ROB_SIZE)
+        return STALL_ROB_FULL;
+
+    for (int i = 0; i < IQ_SIZE; i++) {
+        if (cpu->iq->issueQueue[i].allocated == UNALLOCATED)
+            return STALL_NONE;
+    }
+    return STALL_IQ_FULL;
+}
+
+/*
+ * Adds the branch fused into the instruction in QUEUE to the ROB right
+ * behind it, with the snapshot a BZ/BNZ takes. It never enters the IQ.
+ * dispatch_blocked reserved both ROB entries, so a refused branch means
+ * the ROB and the window disagree: the run stops rather than go on
+ * without the branch.
+ */
+static void dispatch_fused_branch(APEX_CPU *cpu, CPU_Stage *stage) {
+    APEX_Instruction *code = &cpu->code_memory[get_code_index(stage->pc + 4)];
+    CPU_Stage branch = *stage;
+    branch.pc = stage->pc + 4;
+    strcpy(branch.opcode, code->opcode);
+    branch.imm = code->imm;
+    branch.seq = stage->fused_seq;
+    branch.fetch_clock = stage->rename_clock;
+    branch.fused_cfid = 0;
+
+    Rob_entry rob_entry;
+    rob_entry.setStatus(0);
+    rob_entry.setPc_value(branch.pc);
+    rob_entry.setExcodes(-1);
+    rob_entry.setResult(code->imm);
+    rob_entry.setArchiteture_register(-1);
+    rob_entry.setM_unifier_register(-1);
+    rob_entry.setCFID(stage->fused_cfid);
+    URF_data *savedInfo = cpu->urf->takeSnapshot(stage->fused_cfid);
+    rob_entry.setPv_saved_info(savedInfo);
+    if (!cpu->rob->add_instruction_to_ROB(rob_entry)) {
+        printf("\nAPEX_CPU : No ROB entry for the branch fused at pc(%d)\n",
+               stage->pc);
+        isHalt = TRUE;
+        return;
+    }
+    track_dispatch(cpu, &branch, QUEUE, -1, -1, -1, 0, 1);
+}
+
 /*
  * Make the entry in IQ, ROB and LSQ(If neeeded)
  * */
+/*
+ * Load value prediction (--value-pred): a LOAD the predictor is confident
+ * about writes the predicted value to its destination at dispatch, so its
+ * consumers issue with it. memFU checks the value when the LOAD reads
+ * memory.
+ */
+static void predict_load(APEX_CPU *cpu, CPU_Stage *stage) {
+    int value;
+    cpu->stat.vp_loads->inc();
+    if (!cpu->value_pred->predict(stage->pc, &value))
+        return;
+    cpu->urf->URF_Table[stage->u_rd] = value;
+    cpu->urf->URF_TABLE_valid[stage->u_rd] = 1;
+    clear_stale_bus(cpu, stage->u_rd);
+    cpu->iq->updateIssueQueueEntries(stage->u_rd, value);
+    DynInstr &instr = cpu->window->entries.back();
+    instr.predicted = 1;
+    instr.predicted_value = value;
+    cpu->stat.vp_predictions->inc();
+}
+
+/*
+ * Store sets (--mem-dep=1): a dispatched STORE becomes the last of its
+ * set, a dispatched LOAD remembers the STORE of its set it waits for.
+ */
+static void note_store_set(APEX_CPU *cpu, CPU_Stage *stage) {
+    if (strcmp(stage->opcode, "STORE") == 0)
+        cpu->store_sets->dispatch_store(stage->pc, stage->seq);
+    else if (strcmp(stage->opcode, "LOAD") == 0)
+        cpu->window->entries.back().wait_seq =
+                cpu->store_sets->dispatch_load(stage->pc);
+}
+
 int addToQueues(APEX_CPU *cpu) {
     CPU_Stage *stage = &cpu->stage[QUEUE];
     CPU_Stage *int_stage = &cpu->stage[INT_EX];
     CPU_Stage *mul_stage = &cpu->stage[MUL_EX];
 
+    if (stage->stalled) {
+        cpu->stalls->set(QUEUE, STALL_FLUSH);
+        return 0;
+    }
+
+    if (!stage->busy && strlen(stage->opcode) > 0) {
+        int reason = dispatch_blocked(cpu);
+        if (reason != STALL_NONE)
+            return stall_stage(cpu, stage, QUEUE, reason);
+    }
+
     if (!stage->busy && !stage->stalled) {
 
         if (strcmp(stage->opcode, "JAL") == 0) {
@@ -635,12 +1932,13 @@ int addToQueues(APEX_CPU *cpu) {
                 rob_entry.setCFID(entry.CFID);
                 URF_data *savedInfo = cpu->urf->takeSnapshot(entry.CFID);
                 rob_entry.setPv_saved_info(savedInfo);
-                cpu->rob->add_instruction_to_ROB(rob_entry);
+                if (cpu->rob->add_instruction_to_ROB(rob_entry))
+                    track_dispatch(cpu, stage, QUEUE, entry.rd, entry.src1, -1,
+                                   0, 0);
                 int_stage->busy = 0;
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("QUEUE", stage);
-                    memset(stage, 0, sizeof(CPU_Stage));
-                }
+                memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
         }
@@ -673,12 +1971,13 @@ int addToQueues(APEX_CPU *cpu) {
                 rob_entry.setCFID(entry.CFID);
                 URF_data *savedInfo = cpu->urf->takeSnapshot(entry.CFID);
                 rob_entry.setPv_saved_info(savedInfo);
-                cpu->rob->add_instruction_to_ROB(rob_entry);
+                if (cpu->rob->add_instruction_to_ROB(rob_entry))
+                    track_dispatch(cpu, stage, QUEUE, entry.rd, stage->u_rs1, -1, 0,
+                                   0);
                 int_stage->busy = 0;
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("QUEUE", stage);
-                    memset(stage, 0, sizeof(CPU_Stage));
-                }
+                memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
         }
@@ -686,15 +1985,21 @@ int addToQueues(APEX_CPU *cpu) {
         if (strcmp(stage->opcode, "BZ") == 0
             || strcmp(stage->opcode, "BNZ") == 0) {
             IQEntry entry;
-            entry.setStatus();
             entry.pc = stage->pc;
             entry.fuType = stage->fuType;
             entry.src1Valid = -1;
             entry.src2Valid = -1;
             entry.src1Value = -1;
             entry.src2Value = -1;
-            entry.src1 = -1;
+            entry.src1 = stage->u_rs1;
             entry.src2 = -1;
+            if (entry.src1 >= 0) {
+                // Wakes up when the flag setter writes its register
+                entry.src1Value = comparator_rs1(cpu, stage);
+                entry.src1Valid = cpu->urf->URF_TABLE_valid[entry.src1];
+            }
+            if (entry.src1Valid)
+                entry.setStatus();
             entry.rd = -1;
             entry.literal = stage->imm;
             entry.clock = cpu->clock;
@@ -714,12 +2019,13 @@ int addToQueues(APEX_CPU *cpu) {
                 rob_entry.setCFID(entry.CFID);
                 URF_data *savedInfo = cpu->urf->takeSnapshot(entry.CFID);
                 rob_entry.setPv_saved_info(savedInfo);
-                cpu->rob->add_instruction_to_ROB(rob_entry);
+                if (cpu->rob->add_instruction_to_ROB(rob_entry))
+                    track_dispatch(cpu, stage, QUEUE, entry.rd, entry.src1, -1,
+                                   0, 0);
                 int_stage->busy = 0;
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("QUEUE", stage);
-                    memset(stage, 0, sizeof(CPU_Stage));
-                }
+                memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
         }
@@ -755,12 +2061,12 @@ int addToQueues(APEX_CPU *cpu) {
 
                 if (cpu->rob->add_instruction_to_ROB(rob_entry)) { // Adding to ROB
 //					cout << "entry added to ROB" << endl;
+                    track_dispatch(cpu, stage, QUEUE, stage->u_rd, -1, -1, 0, 0);
                 }
                 int_stage->busy = 0;
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("QUEUE", stage);
-                    memset(stage, 0, sizeof(CPU_Stage));
-                }
+                memset(stage, 0, sizeof(CPU_Stage));
                 return 0;
             }
         }
@@ -796,6 +2102,10 @@ int addToQueues(APEX_CPU *cpu) {
             char opcodeTemp[128];
             strcpy(opcodeTemp, stage->opcode);
             strcpy(entry.opcode, opcodeTemp);
+            // LOAD, ADDL and SUBL carry a literal instead of a second source
+            int reads_rs2 = strcmp(stage->opcode, "LOAD") != 0
+                            && strcmp(stage->opcode, "ADDL") != 0
+                            && strcmp(stage->opcode, "SUBL") != 0;
             if (strcmp(stage->opcode, "LOAD") == 0
                 || strcmp(stage->opcode, "STORE") == 0) {
                 //Create an LSQ entry
@@ -820,7 +2130,8 @@ int addToQueues(APEX_CPU *cpu) {
                 if (lsq_index != -1) {
 //					cout << "Added to LSQ" << endl;
                     entry.lsqIndex = lsq_index;
-                }
+                } else
+                    return stall_stage(cpu, stage, QUEUE, STALL_LSQ_FULL);
 
             } else
                 entry.lsqIndex = -1;
@@ -835,22 +2146,70 @@ int addToQueues(APEX_CPU *cpu) {
                 rob_entry.setM_unifier_register(stage->u_rd);
                 rob_entry.setCFID(entry.CFID);
 
-                cpu->rob->add_instruction_to_ROB(rob_entry);
+                if (cpu->rob->add_instruction_to_ROB(rob_entry)) {
+                    track_dispatch(cpu, stage, QUEUE, stage->u_rd, entry.src1,
+                                   reads_rs2 ? entry.src2 : -1,
+                                   entry.lsqIndex != -1, 0);
+                    if (stage->fused_cfid)
+                        dispatch_fused_branch(cpu, stage);
+                    if (cpu->value_pred && strcmp(stage->opcode, "LOAD") == 0)
+                        predict_load(cpu, stage);
+                    if (cpu->store_sets)
+                        note_store_set(cpu, stage);
+                }
 
                 int_stage->busy = 0;
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("QUEUE", stage);
-                    memset(stage, 0, sizeof(CPU_Stage));
-                }
+                memset(stage, 0, sizeof(CPU_Stage));
             }
         }
     }
     return 0;
 }
 
+/*
+ * Resolves the BZ/BNZ fused into 'instr' from the result 'instr' just
+ * wrote, which is what sets the zero flag the branch tests.
+ */
+static void resolve_fused_branch(APEX_CPU *cpu, DynInstr *instr) {
+    int pc = instr->pc + 4;
+    APEX_Instruction *code = &cpu->code_memory[get_code_index(pc)];
+    int zero = cpu->urf->URF_Table[instr->u_rd] == 0;
+    int taken = code->op == OP_BZ ? zero : !zero;
+
+    IQEntry branch;
+    branch.pc = pc;
+    branch.fuType = INT_FU;
+    strcpy(branch.opcode, code->opcode);
+    branch.literal = code->imm;
+    branch.CFID = instr->fused_cfid;
+    branch.clock = instr->dispatch_clock;
+
+    record_branch_outcome(cpu, &branch, taken);
+    if (taken) {
+        squash_after_branch(cpu, &branch, 1);
+        cpu->pc = pc + code->imm;
+    }
+    cpu->rob->update_ROB_slot(pc, branch.CFID, -1, VALID, code->imm);
+    complete_instr(cpu, cpu->window->get(branch.clock, pc));
+}
+
 /*
  *  INT Function Unit Stage of APEX Pipeline
  */
+/*
+ * Zero flag a BZ/BNZ in INT FU tests. Every flag setter sets it exactly
+ * when its result is zero, so the value of the renamed flag register,
+ * captured like any source operand, gives it. Without a setter in flight
+ * at decode the committed flag is already final.
+ */
+static int branch_zero_flag(APEX_CPU *cpu, CPU_Stage *stage) {
+    if (stage->u_rs1 >= 0)
+        return stage->rs1_value == 0;
+    return cpu->zero_flag;
+}
+
 int intFU(APEX_CPU *cpu) {
     CPU_Stage *int_stage = &cpu->stage[INT_EX];
     CPU_Stage *mem_stage = &cpu->stage[MEM_EX];
@@ -868,7 +2227,8 @@ int intFU(APEX_CPU *cpu) {
         IQEntry mem_instruction = cpu->iq->getNextInstructionToIssue(LS_FU);
         if (mem_instruction.fuType == LS_FU
             && mem_instruction.getStatus() == 1) {
-            printf("ALLOCATED IQ : %d\n", mem_instruction.allocated);
+            if (ENABLE_DEBUG_MESSAGES)
+                printf("ALLOCATED IQ : %d\n", mem_instruction.allocated);
             int_stage->pc = mem_instruction.pc;
             strcpy(int_stage->opcode, mem_instruction.opcode);
             int_stage->u_rs1 = mem_instruction.src1;
@@ -887,6 +2247,8 @@ int intFU(APEX_CPU *cpu) {
             //Print before removing it
             print_register_status(cpu);
             int res = cpu->iq->removeEntry(&mem_instruction);
+            issue_instr(cpu, &mem_instruction, "Ag");
+            cpu->stalls->set(INT_EX, STALL_NONE);
             int mem_address;
             if (strcmp(int_stage->opcode, "STORE") == 0)
                 mem_address = int_stage->rs2_value + int_stage->imm;
@@ -895,14 +2257,16 @@ int intFU(APEX_CPU *cpu) {
             //Update lsq with memory address.
             cpu->lsq->update_LSQ_index(mem_instruction.lsqIndex, 1,
                                        mem_address);
+            DynInstr *mem = cpu->window->get(mem_instruction.clock,
+                                             mem_instruction.pc);
+            if (mem)
+                mem->mem_address = mem_address;
             mem_stage->busy = 0;
-            if (ENABLE_DEBUG_MESSAGES) {
+            if (ENABLE_DEBUG_MESSAGES)
                 print_stage_content("INT FU", int_stage);
-                // result is calculated so just memset this.
-                memset(int_stage, 0, sizeof(CPU_Stage));
-
-                return 0;
-            }
+            // result is calculated so just memset this.
+            memset(int_stage, 0, sizeof(CPU_Stage));
+            return 0;
         }
 
         //INTEGER type instruction
@@ -925,123 +2289,45 @@ int intFU(APEX_CPU *cpu) {
                 //Print before removing it
                 print_register_status(cpu);
                 cpu->iq->removeEntry(&insToExec);
+                issue_instr(cpu, &insToExec, "Ex");
+                cpu->stalls->set(INT_EX, STALL_NONE);
             }
 
             if (strcmp(int_stage->opcode, "BZ") == 0) {
-                int flag;
-                int tempSID = cpu->rob->get_slot_id_from_cfid(insToExec.CFID,
-                                                              int_stage->pc);
-                Rob_entry *thisEntry = &cpu->rob->rob_queue[tempSID];
-                if (cpu->rob->check_with_rob_head(int_stage->pc)) {
-                    //TRUE: Branch is on head. take zero flag from cpu
-                    flag = cpu->zero_flag;
-                } else {
-                    flag = cpu->rob->get_zero_flag_at_slot_id(tempSID);
-                    //@TODO If MOVC is in between arithmetic and branch in rob
-                }
+                int flag = branch_zero_flag(cpu, int_stage);
 
+                record_branch_outcome(cpu, &insToExec, flag == 1);
                 if (flag == 1) {
                     //Take the branch
-                    memset(drf_stage, 0, sizeof(CPU_Stage));
-                    memset(queue_stage, 0, sizeof(CPU_Stage));
-                    drf_stage->stalled = 1;
-                    queue_stage->stalled = 1;
-                    fetch_stage->stalled = 1;
-                    //FLUSH ROB
-                    cpu->rob->flush_ROB_entries(tempSID, cpu);
-                    //FLUSH not only IQ but also LSQ
-                    int mostRecentCFID = cpu->btb->last_control_flow_instr;
-
-                    deque<int> cfidDeque = cpu->btb->CF_instn_order;
-                    deque<int>::iterator itr;
-                    itr = find(cfidDeque.begin(), cfidDeque.end(), insToExec.CFID);
-                    for (; itr != cfidDeque.end(); itr++) {
-                        int tempCFID = *itr;
-                        cpu->iq->flushIQEntries(tempCFID, insToExec.pc);
-                        cpu->lsq->flushLSQEntries(tempCFID);
-                    }
-
-                    //Restoring Snapshot
-                    URF_data *temp;
-                    temp = (URF_data *) thisEntry->getPv_saved_info();
-                    cpu->urf->restoreSnapshot(*temp);
-
-
+                    squash_after_branch(cpu, &insToExec, 1);
                     cpu->pc = int_stage->pc + int_stage->imm;
                 }
 
                 // update
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID, -1,
                                           VALID, int_stage->imm);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
             }
 
             if (strcmp(int_stage->opcode, "JUMP") == 0) {
-                int tempSID = cpu->rob->get_slot_id_from_cfid(insToExec.CFID,
-                                                              int_stage->pc);
-                Rob_entry *thisEntry = &cpu->rob->rob_queue[tempSID];
-                memset(drf_stage, 0, sizeof(CPU_Stage));
-                memset(queue_stage, 0, sizeof(CPU_Stage));
-                drf_stage->stalled = 1;
-                queue_stage->stalled = 1;
-                fetch_stage->stalled = 1;
-
-                //FLUSH ROB
-                cpu->rob->flush_ROB_entries(tempSID, cpu);
-                //FLUSH not only IQ but also LSQ
-                int mostRecentCFID = cpu->btb->last_control_flow_instr;
-                deque<int> cfidDeque = cpu->btb->CF_instn_order;
-                deque<int>::iterator itr;
-                itr = find(cfidDeque.begin(), cfidDeque.end(), insToExec.CFID);
-                for (; itr != cfidDeque.end(); itr++) {
-                    int tempCFID = *itr;
-                    cpu->iq->flushIQEntries(tempCFID, insToExec.pc);
-                    cpu->lsq->flushLSQEntries(tempCFID);
-                }
-
-                //Restoring Snapshot
-                URF_data *temp;
-                temp = (URF_data *) thisEntry->getPv_saved_info();
-                cpu->urf->restoreSnapshot(*temp);
+                record_branch_outcome(cpu, &insToExec, 1);
+                squash_after_branch(cpu, &insToExec, 1);
 
                 cpu->pc = int_stage->rs1_value + int_stage->imm;
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID, -1,
                                           VALID, int_stage->imm);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
             }
 
             if (strcmp(int_stage->opcode, "JAL") == 0) {
-                int tempSID = cpu->rob->get_slot_id_from_cfid(insToExec.CFID,
-                                                              int_stage->pc);
-                Rob_entry *thisEntry = &cpu->rob->rob_queue[tempSID];
-                memset(drf_stage, 0, sizeof(CPU_Stage));
-                memset(queue_stage, 0, sizeof(CPU_Stage));
-                drf_stage->stalled = 1;
-                queue_stage->stalled = 1;
-                //FLUSH ROB
-                cpu->rob->flush_ROB_entries(tempSID, cpu);
-                //FLUSH not only IQ but also LSQ
-                int mostRecentCFID = cpu->btb->last_control_flow_instr;
-                deque<int> cfidDeque = cpu->btb->CF_instn_order;
-                deque<int>::iterator itr;
-                itr = find(cfidDeque.begin(), cfidDeque.end(), insToExec.CFID);
-                for (; itr != cfidDeque.end(); itr++) {
-                    int tempCFID = *itr;
-                    cpu->iq->flushIQEntries(tempCFID, insToExec.pc);
-                    cpu->lsq->flushLSQEntries(tempCFID);
-                }
-                //Restoring Snapshot
-                URF_data *temp;
-                temp = (URF_data *) thisEntry->getPv_saved_info();
-                cpu->urf->restoreSnapshot(*temp);
+                record_branch_outcome(cpu, &insToExec, 1);
+                squash_after_branch(cpu, &insToExec, 0);
 
                 cpu->pc = int_stage->rs1_value + int_stage->imm;
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID, -1,
@@ -1062,63 +2348,29 @@ int intFU(APEX_CPU *cpu) {
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID,
                                           int_stage->zeroFlag, VALID, buffer);
                 cpu->iq->updateIssueQueueEntries(int_stage->u_rd, buffer);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
             }
 
             if (strcmp(int_stage->opcode, "BNZ") == 0) {
-                int flag;
-                int tempSID = cpu->rob->get_slot_id_from_cfid(insToExec.CFID,
-                                                              int_stage->pc);
-                Rob_entry *thisEntry = &cpu->rob->rob_queue[tempSID];
-                if (cpu->rob->check_with_rob_head(int_stage->pc)) {
-                    //TRUE: Branch is on head. take zero flag from cpu
-                    flag = cpu->zero_flag;
-                } else {
-                    int prev_Slot = tempSID - 1;
-                    flag = cpu->rob->get_zero_flag_at_slot_id(prev_Slot);
-                    //@TODO If MOVC is in between arithmetic and branch in rob
-                }
+                int flag = branch_zero_flag(cpu, int_stage);
 
+                record_branch_outcome(cpu, &insToExec, flag == 0);
                 if (flag == 0) {        // if zero flag is not set, take branch
                     //Take the branch
-                    memset(drf_stage, 0, sizeof(CPU_Stage));
-                    memset(queue_stage, 0, sizeof(CPU_Stage));
-                    drf_stage->stalled = 1;
-                    queue_stage->stalled = 1;
-                    fetch_stage->stalled = 1;
-                    //FLUSH ROB
-                    cpu->rob->flush_ROB_entries(tempSID, cpu);
-                    //FLUSH not only IQ but also LSQ
-                    int mostRecentCFID = cpu->btb->last_control_flow_instr;
-                    deque<int> cfidDeque = cpu->btb->CF_instn_order;
-                    deque<int>::iterator itr;
-                    itr = find(cfidDeque.begin(), cfidDeque.end(), insToExec.CFID);
-                    for (; itr != cfidDeque.end(); itr++) {
-                        int tempCFID = *itr;
-                        cpu->iq->flushIQEntries(tempCFID, insToExec.pc);
-                        cpu->lsq->flushLSQEntries(tempCFID);
-                    }
-
-                    //Restoring Snapshot
-                    URF_data *temp;
-                    temp = (URF_data *) thisEntry->getPv_saved_info();
-                    cpu->urf->restoreSnapshot(*temp);
-
+                    squash_after_branch(cpu, &insToExec, 1);
                     cpu->pc = int_stage->pc + int_stage->imm;
                 }
 
                 // update
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID, -1,
                                           VALID, int_stage->imm);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
             }
 
 
@@ -1134,11 +2386,10 @@ int intFU(APEX_CPU *cpu) {
                                           VALID, int_stage->imm);
                 cpu->iq->updateIssueQueueEntries(int_stage->u_rd,
                                                  int_stage->imm);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
 
             }
 
@@ -1158,15 +2409,14 @@ int intFU(APEX_CPU *cpu) {
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID,
                                           int_stage->zeroFlag, VALID, buffer);
                 cpu->iq->updateIssueQueueEntries(int_stage->u_rd, buffer);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
             }
 
             if (strcmp(int_stage->opcode, "SUBL") == 0) {
-                int buffer = int_stage->rs1_value + int_stage->imm;
+                int buffer = int_stage->rs1_value - int_stage->imm;
                 cpu->urf->URF_Table[int_stage->u_rd] = buffer;
                 cpu->urf->URF_TABLE_valid[int_stage->u_rd] = 1;
 
@@ -1181,11 +2431,10 @@ int intFU(APEX_CPU *cpu) {
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID,
                                           int_stage->zeroFlag, VALID, buffer);
                 cpu->iq->updateIssueQueueEntries(int_stage->u_rd, buffer);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
             }
 
             if (strcmp(int_stage->opcode, "ADD") == 0
@@ -1225,17 +2474,25 @@ int intFU(APEX_CPU *cpu) {
                 cpu->rob->update_ROB_slot(int_stage->pc, insToExec.CFID,
                                           int_stage->zeroFlag, VALID, buffer);
                 cpu->iq->updateIssueQueueEntries(int_stage->u_rd, buffer);
-                if (ENABLE_DEBUG_MESSAGES) {
+                if (ENABLE_DEBUG_MESSAGES)
                     print_stage_content("INT FU", int_stage);
-                    // result is calculated so just memset this.
-                    memset(int_stage, 0, sizeof(CPU_Stage));
-                }
+                // result is calculated so just memset this.
+                memset(int_stage, 0, sizeof(CPU_Stage));
             }
 
 
 
             // Update ROB here.
 
+            // INT FU is single cycle, anything issued this cycle is complete
+            if (insToExec.fuType == INT_FU && insToExec.getStatus() == 1) {
+                DynInstr *instr = cpu->window->get(insToExec.clock,
+                                                   insToExec.pc);
+                complete_instr(cpu, instr);
+                if (instr && instr->fused_cfid)
+                    resolve_fused_branch(cpu, instr);
+            }
+
             //@discuss:
             //  - Once FU is free, shall it take 'next instruction directly from IQ?'
         }
@@ -1255,6 +2512,14 @@ int mulFU(APEX_CPU *cpu) {
 
 // @discuss: here, we r just checking FU is stalled or not
 
+    // A ready MUL waiting behind the one in flight is a structural stall
+    int reason = STALL_EMPTY;
+    if (iMulCycleSpent != 0) {
+        IQEntry waiting = cpu->iq->getNextInstructionToIssue(MUL_FU);
+        if (waiting.fuType == MUL_FU && waiting.getStatus() == 1)
+            reason = STALL_MUL_BUSY;
+    }
+
     if (!mul_stage->stalled && iMulCycleSpent == 0) { // Only transfer if FU is free.
         IQEntry insToExec = cpu->iq->getNextInstructionToIssue(MUL_FU);
         if (insToExec.fuType == MUL_FU && insToExec.getStatus() == 1) {
@@ -1272,10 +2537,12 @@ int mulFU(APEX_CPU *cpu) {
             mul_stage->u_rs1_valid = insToExec.src1Valid;
             mul_stage->u_rs2_valid = insToExec.src2Valid;
             mul_stage->CFID = insToExec.CFID;
+            mul_stage->dispatch_clock = insToExec.clock;
 
             //Print before removing it
             print_register_status(cpu);
             cpu->iq->removeEntry(&insToExec);
+            issue_instr(cpu, &insToExec, "Ex");
         }
 
     }
@@ -1285,6 +2552,8 @@ int mulFU(APEX_CPU *cpu) {
 
         if (strcmp(mul_stage->opcode, "MUL") == 0) {
             iMulCycleSpent++;
+            if (reason == STALL_EMPTY)
+                reason = STALL_NONE;
         }
         // This is 2nd cycle we are done.
         if (iMulCycleSpent == 2) {
@@ -1307,6 +2576,9 @@ int mulFU(APEX_CPU *cpu) {
                                       VALID, buffer);
             cpu->iq->updateIssueQueueEntries(mul_stage->u_rd, buffer);
 
+            complete_instr(cpu,
+                    cpu->window->get(mul_stage->dispatch_clock, mul_stage->pc));
+
             mul_stage->stalled = 0;
             iMulCycleSpent = 0;
 
@@ -1317,9 +2589,153 @@ int mulFU(APEX_CPU *cpu) {
             print_stage_content("MUL FU", mul_stage);
         }
     }
+    cpu->stalls->set(MUL_EX, reason);
     return 0;
 }
 
+/*
+ * With --mem-dep, memFU may run a LOAD whose address is known ahead of an
+ * LSQ head that cannot go yet. The LOAD still waits for an older STORE to
+ * the same known address and, with store sets, for the STORE of its set;
+ * an older STORE whose address is not known yet does not hold it back.
+ * Returns NULL if no LOAD can go.
+ */
+static DynInstr *find_early_load(APEX_CPU *cpu) {
+    InstrWindow *window = cpu->window;
+    DynInstr *head = window->oldest_mem();
+    for (int i = 0; i < window->size(); i++) {
+        DynInstr &instr = window->entries[i];
+        if (!instr.is_mem || &instr == head
+            || cpu->itable[get_code_index(instr.pc)].op != OP_LOAD)
+            continue;
+        // A predicted LOAD is checked at the ROB head, where it can replay
+        if (instr.early || instr.predicted || instr.mem_address < 0
+            || !cpu->data_memory->can_access(instr.mem_address))
+            continue;
+
+        bool blocked = false;
+        for (int j = 0; j < i && !blocked; j++) {
+            DynInstr &older = window->entries[j];
+            if (!older.is_mem
+                || cpu->itable[get_code_index(older.pc)].op != OP_STORE)
+                continue;
+            if (older.mem_address == instr.mem_address) {
+                blocked = true;
+            } else if (older.seq == instr.wait_seq) {
+                blocked = true;
+                if (!instr.held)
+                    cpu->stat.held_loads->inc();
+                instr.held = 1;
+            }
+        }
+        if (!blocked)
+            return &instr;
+    }
+    return NULL;
+}
+
+/*
+ * Last of the three memFU cycles of a LOAD run ahead: its value trains
+ * the value predictor and goes to the URF and its consumers, but its ROB
+ * entry only becomes valid when the LSQ reaches it (drain_early_loads).
+ */
+static void finish_early_load(APEX_CPU *cpu, CPU_Stage *stage) {
+    DynInstr *instr = cpu->window->get(stage->dispatch_clock, stage->pc);
+    if (instr) {
+        int value;
+        if (cpu->store_buffer
+            && cpu->store_buffer->forward(stage->mem_address, &value))
+            cpu->stat.sb_forwarded->inc();
+        else
+            value = cpu->data_memory->peek(stage->mem_address);
+        if (cpu->value_pred)
+            cpu->value_pred->train(stage->pc, value);
+        cpu->urf->URF_Table[stage->u_rd] = value;
+        cpu->urf->URF_TABLE_valid[stage->u_rd] = 1;
+        cpu->iq->updateIssueQueueEntries(stage->u_rd, value);
+        cpu->mem_bus.r = stage->u_rd;
+        cpu->mem_bus.r_value = value;
+        instr->early = 1;
+        instr->early_value = value;
+        complete_instr(cpu, instr);
+        cpu->stat.early_loads->inc();
+    }
+    memEarlyLoad = 0;
+    memCycleSpent = 0;
+    memset(stage, 0, sizeof(CPU_Stage));
+}
+
+// LOADs run ahead leave the LSQ in order, once everything older has.
+static void drain_early_loads(APEX_CPU *cpu) {
+    while (!cpu->lsq->isempty()) {
+        DynInstr *instr = cpu->window->oldest_mem();
+        if (!instr || !instr->early)
+            return;
+        LSQ_entry *head = cpu->lsq->check_head_instruction_from_LSQ();
+        cpu->rob->update_ROB_slot(head->m_pc, head->CFID, -1, VALID,
+                                  instr->early_value);
+        cpu->lsq->retire_instruction_from_LSQ();
+        instr->is_mem = 0;
+    }
+}
+
+/*
+ * A STORE at the ROB head has written memory. LOADs its store set held
+ * back for it count as avoided violations; a younger LOAD that already
+ * read the address is a violation, trains the store sets and replays
+ * everything after the STORE.
+ */
+static void check_store_order(APEX_CPU *cpu, DynInstr *store, int cfid) {
+    int pc = store->pc;
+    if (cpu->store_sets)
+        cpu->store_sets->execute_store(pc, store->seq);
+    for (int i = 0; i < cpu->window->size(); i++) {
+        DynInstr &load = cpu->window->entries[i];
+        if (load.mem_address != store->mem_address
+            || cpu->itable[get_code_index(load.pc)].op != OP_LOAD)
+            continue;
+        if (load.early) {
+            cpu->stat.violations->inc();
+            if (cpu->store_sets)
+                cpu->store_sets->violation(load.pc, pc);
+            squash_after_mem(cpu, pc, cfid, -1);
+            return;
+        }
+        if (load.held && load.wait_seq == store->seq)
+            cpu->stat.violations_avoided->inc();
+    }
+}
+
+/*
+ * A STORE at the ROB head moves from the LSQ into the store buffer in one
+ * memFU cycle and is complete; the memory write happens in the background.
+ */
+static void buffer_store(APEX_CPU *cpu, CPU_Stage *stage) {
+    LSQ_entry *head = cpu->lsq->check_head_instruction_from_LSQ();
+    Rob_entry *headEntry = cpu->rob->get_head_instruction_from_ROB();
+    DynInstr *instr = cpu->window->oldest_mem();
+    int cfid = head->CFID;
+    int address = stage->mem_address;
+
+    if (cpu->store_buffer->insert(stage->pc, address, stage->rs1_value))
+        cpu->stat.sb_coalesced->inc();
+    cpu->stalls->set(MEM_EX, STALL_NONE);
+    cpu->stat.fu_issued[LS_FU]->inc();
+    if (cpu->kanata && instr)
+        cpu->kanata->stage(cpu->clock, instr->seq, "Mem");
+
+    headEntry->setStatus(VALID);
+    complete_instr(cpu, instr);
+    cpu->lsq->retire_instruction_from_LSQ();
+    memset(stage, 0, sizeof(CPU_Stage));
+    if (instr) {
+        instr->mem_address = address;
+        instr->is_mem = 0;
+        if (apex_config.mem_dep)
+            check_store_order(cpu, instr, cfid);
+    }
+}
+
 /*
  *  Memory Stage of APEX Pipeline
  *
@@ -1329,6 +2745,16 @@ int mulFU(APEX_CPU *cpu) {
 int memFU(APEX_CPU *cpu) {
     CPU_Stage *stage = &cpu->stage[MEM_EX];
 
+    // A flush may have dropped the LOAD run ahead
+    if (memEarlyLoad && !cpu->window->get(stage->dispatch_clock, stage->pc)) {
+        memEarlyLoad = 0;
+        memCycleSpent = 0;
+        memset(stage, 0, sizeof(CPU_Stage));
+    }
+    if (memCycleSpent == 0 || memEarlyLoad)
+        drain_early_loads(cpu);
+    drain_store_buffer(cpu, 0);
+
 // Memmory instruction spends 2-cycles.
     if(cpu->lsq->isempty())
         return 0;
@@ -1350,12 +2776,63 @@ int memFU(APEX_CPU *cpu) {
         stage->busy = 0;
     }
 
+    if (!stage->busy && !stage->stalled && cpu->store_buffer
+        && memCycleSpent == 0 && strcmp(stage->opcode, "STORE") == 0) {
+        LSQ_entry *head = cpu->lsq->check_head_instruction_from_LSQ();
+        if (head->getM_status() == 1
+            && cpu->rob->check_with_rob_head(head->m_pc)
+            && cpu->data_memory->can_access(stage->mem_address)) {
+            if (cpu->store_buffer->accepts(stage->mem_address)) {
+                buffer_store(cpu, stage);
+            } else {
+                cpu->stat.sb_full->inc();
+                cpu->stalls->set(MEM_EX, STALL_MEM_BUSY);
+            }
+            return 0;
+        }
+    }
+
+    if (!stage->busy && !stage->stalled && memEarlyLoad) {
+        memCycleSpent++;
+        cpu->stalls->set(MEM_EX, STALL_NONE);
+        if (memCycleSpent == 3)
+            finish_early_load(cpu, stage);
+        return 0;
+    }
+
     if (!stage->busy && !stage->stalled) {
         LSQ_entry *insToExecMem = cpu->lsq->check_head_instruction_from_LSQ();
+        DynInstr *early;
 
         if (insToExecMem->getM_status() == 1
             && cpu->rob->check_with_rob_head(insToExecMem->m_pc)) {
             memCycleSpent++;
+            cpu->stalls->set(MEM_EX, STALL_NONE);
+            if (memCycleSpent == 1) {
+                cpu->stat.fu_issued[LS_FU]->inc();
+                DynInstr *instr = cpu->window->oldest_mem();
+                if (cpu->kanata && instr)
+                    cpu->kanata->stage(cpu->clock, instr->seq, "Mem");
+            }
+        } else if (apex_config.mem_dep && memCycleSpent == 0
+                   && (early = find_early_load(cpu))) {
+            // The head waits, a younger LOAD takes memFU meanwhile
+            memset(stage, 0, sizeof(CPU_Stage));
+            stage->pc = early->pc;
+            strcpy(stage->opcode, "LOAD");
+            stage->mem_address = early->mem_address;
+            stage->u_rd = early->u_rd;
+            stage->dispatch_clock = early->dispatch_clock;
+            memEarlyLoad = 1;
+            memCycleSpent = 1;
+            cpu->stalls->set(MEM_EX, STALL_NONE);
+            cpu->stat.fu_issued[LS_FU]->inc();
+            if (cpu->kanata)
+                cpu->kanata->stage(cpu->clock, early->seq, "Mem");
+            return 0;
+        } else {
+            // LSQ head still waits for its address or for the ROB head
+            cpu->stalls->set(MEM_EX, STALL_MEM_BUSY);
         }
         if (ENABLE_DEBUG_MESSAGES) {
             print_stage_content("MEMORY FU", stage);
@@ -1364,33 +2841,69 @@ int memFU(APEX_CPU *cpu) {
         // This is 3rd cycle we are done.
         if (memCycleSpent == 3) {
 
+            // The ROB head is complete, commit() retires it
+            Rob_entry *headEntry = cpu->rob->get_head_instruction_from_ROB();
+            DynInstr *instr = cpu->window->oldest_mem();
+            if (instr)
+                instr->mem_address = stage->mem_address;
             if (strcmp(stage->opcode, "STORE") == 0) {
-                //Store to the memory
-                cpu->data_memory[stage->mem_address] = stage->rs1_value;
+                //Store to the memory, a faulting store stops the machine
+                if (!cpu->data_memory->write(stage->pc, stage->mem_address,
+                                             stage->rs1_value))
+                    isHalt = TRUE;
+                headEntry->setStatus(VALID);
+                complete_instr(cpu, instr);
+                int store_cfid = insToExecMem->CFID;
                 cpu->lsq->retire_instruction_from_LSQ();
-                if(AnyInstructionRetired<2) {
-                    cpu->rob->retire_instruction_from_ROB();
-                    AnyInstructionRetired++;
-                }
 
                 stage->stalled = 0;
                 memCycleSpent = 0;
+                if (instr) {
+                    instr->is_mem = 0;
+                    if (apex_config.mem_dep)
+                        check_store_order(cpu, instr, store_cfid);
+                }
             } else if (strcmp(stage->opcode, "LOAD") == 0) {
                 //First check from the previous checks if the load status is valid.
-                int buffer = cpu->data_memory[insToExecMem->m_memory_addr];
+                int buffer;
+                if (cpu->store_buffer
+                    && cpu->store_buffer->forward(insToExecMem->m_memory_addr,
+                                                  &buffer))
+                    cpu->stat.sb_forwarded->inc();
+                else if (!cpu->data_memory->read(stage->pc,
+                                                 insToExecMem->m_memory_addr,
+                                                 &buffer))
+                    isHalt = TRUE;
+                int load_cfid = insToExecMem->CFID;
+                int dest = insToExecMem->m_dest_reg;
+                int mispredicted = instr && instr->predicted
+                                   && instr->predicted_value != buffer;
+                if (cpu->value_pred)
+                    cpu->value_pred->train(stage->pc, buffer);
                 cpu->urf->URF_Table[insToExecMem->m_dest_reg] = buffer;
                 cpu->urf->URF_TABLE_valid[insToExecMem->m_dest_reg] = 1;
                 cpu->iq->updateIssueQueueEntries(insToExecMem->m_dest_reg,
                                                  buffer);
-               // if(AnyInstructionRetired<2) {
-                    cpu->rob->retire_instruction_from_ROB();
-                  //  AnyInstructionRetired++;
-               // }
+                headEntry->setResult(buffer);
+                headEntry->setStatus(VALID);
+                complete_instr(cpu, instr);
 
                 //updating bus
                 cpu->mem_bus.r = insToExecMem->m_dest_reg;
                 cpu->mem_bus.r_value = buffer;
                 cpu->lsq->retire_instruction_from_LSQ();
+                if (instr)
+                    instr->is_mem = 0;
+
+                // Consumers of a wrong predicted value are replayed
+                if (instr && instr->predicted) {
+                    if (mispredicted) {
+                        cpu->stat.vp_mispredicts->inc();
+                        squash_after_mem(cpu, stage->pc, load_cfid, dest);
+                    } else {
+                        cpu->stat.vp_correct->inc();
+                    }
+                }
 
                 stage->stalled = 0;
                 memCycleSpent = 0;
@@ -1405,6 +2918,9 @@ int memFU(APEX_CPU *cpu) {
 
 /*
  *  Retire Instruction Stage of APEX Pipeline (WB)
+ *
+ *  Retires the ROB head if it is complete. Returns 1 if an instruction
+ *  left the ROB, 0 if the head is empty or still waiting.
  */
 int retireInstruction(APEX_CPU *cpu) {
 
@@ -1413,23 +2929,44 @@ int retireInstruction(APEX_CPU *cpu) {
 
         Rob_entry *headEntry = cpu->rob->get_head_instruction_from_ROB();
 
+        APEX_Decoded_Instruction *head_ins =
+                &cpu->itable[get_code_index(headEntry->m_pc_value)];
+
         // If its HALT
-        map<int, APEX_Instruction *>::iterator itr = (cpu->imap)->find(
-                headEntry->m_pc_value);
-        if (strcmp(itr->second->opcode, "HALT") == 0) {
+        if (head_ins->op == OP_HALT) {
             isHalt = TRUE;
+            // Buffered STOREs are committed, memory holds them from here on
+            drain_store_buffer(cpu, 1);
             headEntry->setslot_status(UNALLOCATED);
             cpu->rob->retire_instruction_from_ROB();
+            retire_from_window(cpu);
+            cpu->stalls->set(WB, STALL_NONE);
             cpu->ins_completed++;
-            cout<<"HALT succesfull..!!"<<endl;
+            cosim_commit(cpu, headEntry->m_pc_value, -1);
+            if (ENABLE_DEBUG_MESSAGES)
+                cout<<"HALT succesfull..!!"<<endl;
+            return 1;
+
+        } else if (head_ins->op == OP_ROI_BEGIN || head_ins->op == OP_ROI_END) {
+            // Markers themselves are outside the region
+            if (head_ins->op == OP_ROI_END)
+                roi_end(cpu, cpu->clock);
+            headEntry->setslot_status(UNALLOCATED);
+            cpu->rob->retire_instruction_from_ROB();
+            retire_from_window(cpu);
+            cpu->ins_completed++;
+            cosim_commit(cpu, headEntry->m_pc_value, -1);
+            if (head_ins->op == OP_ROI_BEGIN)
+                roi_begin(cpu, cpu->clock);
+            cpu->stalls->set(WB, STALL_NONE);
+            return 1;
 
         } else {
             int rd_status = headEntry->m_status;
             if (rd_status == VALID) {
 
                 // If retiring instruction is BRANCH, add back CFID to free list.
-                if (strcmp(itr->second->opcode, "BZ") == 0
-                    || strcmp(itr->second->opcode, "BNZ") == 0) {
+                if (head_ins->is_control_flow) {
                     cpu->btb->add_CFID_to_free_list(headEntry->m_CFID);
                 }
 
@@ -1448,20 +2985,39 @@ int retireInstruction(APEX_CPU *cpu) {
 
                  */
 
-                //Dont free the register immediately unless it's renamer instruction comes.
-                //Just update the register content to B-RAT
-                cpu->urf->B_RAT[headEntry->m_architeture_register] =
-                        headEntry->m_unified_register;
-                //cpu->urf->URF_Table[headEntry->m_unified_register]; //@discuss: changed as per notes.
+                // The committed mapping this one replaces loses its B-RAT
+                // reference, unless an early release already dropped it
+                int mem_address = -1;
+                int prev_released = 0;
+                if (cpu->window->size() > 0) {
+                    mem_address = cpu->window->entries.front().mem_address;
+                    prev_released = cpu->window->entries.front().prev_released;
+                }
+                // Once the setter commits, zero_flag holds its flag
+                if (head_ins->sets_flag
+                    && cpu->flag_reg == headEntry->m_unified_register)
+                    cpu->flag_reg = -1;
+                if (head_ins->writes_rd) {
+                    int arch = headEntry->m_architeture_register;
+                    int prev = cpu->urf->B_RAT[arch];
+                    if (!prev_released && cpu->free_list->release(prev))
+                        cpu->stat.urf_freed_commit->inc();
+                    cpu->urf->B_RAT[arch] = headEntry->m_unified_register;
+                }
                 cpu->rob->retire_instruction_from_ROB();
-                cpu->zero_flag = headEntry->m_excodes;
+                retire_from_window(cpu);
+                cpu->stalls->set(WB, STALL_NONE);
+                // MOVC, memory and control flow carry no flag (-1)
+                if (headEntry->m_excodes != -1)
+                    cpu->zero_flag = headEntry->m_excodes;
                 cpu->ins_completed++;
+                cosim_commit(cpu, headEntry->m_pc_value, mem_address);
 
                 if (ENABLE_DEBUG_MESSAGES) {
                     /*
                      CPU_Stage *stage;
                      int pc_value = headEntry->getPc_value();
-                     APEX_Instruction *current_ins = cpu->imap->find(pc_value)->second;
+                     APEX_Instruction *current_ins = &cpu->code_memory[get_code_index(pc_value)];
                      strcpy(stage->opcode, current_ins->opcode);
                      stage->rd = current_ins->rd;
                      stage->rs1 = current_ins->rs1;
@@ -1471,12 +3027,80 @@ int retireInstruction(APEX_CPU *cpu) {
                      print_stage_content("ROB Retired Instructions", stage);
                      */
                 }
+                return 1;
+            } else {
+                // Head is not complete yet, charge it to the unit it waits on
+                if (head_ins->is_mem)
+                    cpu->stalls->set(WB, STALL_MEM_BUSY);
+                else if (head_ins->fu_type == MUL_FU)
+                    cpu->stalls->set(WB, STALL_MUL_BUSY);
+                else
+                    cpu->stalls->set(WB, STALL_EXEC_WAIT);
             }
         }
     }
     return 0;
 }
 
+/*
+ * Early release (--early-release=1): the mapping an in-flight instruction
+ * replaced goes back to the free list before that instruction commits,
+ * once its value is written, every older reader has completed and no
+ * older control flow, predicted LOAD or (with --mem-dep) STORE is
+ * unresolved, so no flush can restore it. A register that still holds
+ * the renamed zero flag is kept. The B-RAT may then name a reused
+ * register until the redefinition commits.
+ */
+static void release_early(APEX_CPU *cpu) {
+    InstrWindow *window = cpu->window;
+    for (int i = 0; i < window->size(); i++) {
+        DynInstr &instr = window->entries[i];
+        int prev = instr.prev_u_rd;
+        if (prev >= 0 && !instr.prev_released && prev != cpu->flag_reg
+            && cpu->urf->URF_TABLE_valid[prev]) {
+            bool read = true;
+            for (int j = 0; j < i && read; j++) {
+                DynInstr &older = window->entries[j];
+                if ((older.src1 == prev || older.src2 == prev)
+                    && older.complete_clock < 0)
+                    read = false;
+            }
+            if (read) {
+                instr.prev_released = 1;
+                if (cpu->free_list->release(prev))
+                    cpu->stat.urf_freed_early->inc();
+            }
+        }
+        // Everything younger is still speculative
+        APEX_Decoded_Instruction *ins = &cpu->itable[get_code_index(instr.pc)];
+        if ((ins->is_control_flow || instr.predicted
+             || (apex_config.mem_dep && ins->op == OP_STORE))
+            && instr.complete_clock < 0)
+            break;
+    }
+}
+
+/*
+ * Commit stage: retires up to --commit-width instructions from the ROB
+ * head, in order, stopping at the first one that is not complete. A cycle
+ * that used the whole width while the next head was already complete
+ * counts as commit-width limited. Early release, if enabled, runs after
+ * the retirements.
+ */
+static void commit(APEX_CPU *cpu) {
+    int committed = 0;
+    while (committed < apex_config.commit_width && isHalt != TRUE
+           && retireInstruction(cpu))
+        committed++;
+    cpu->stat.committed->sample(committed);
+    if (committed == apex_config.commit_width && isHalt != TRUE
+        && cpu->window->size() > 0
+        && cpu->window->entries.front().complete_clock >= 0)
+        cpu->stat.commit_width_limited->inc();
+    if (apex_config.early_release)
+        release_early(cpu);
+}
+
 /*
  *  APEX CPU simulation loop
  *
@@ -1499,34 +3123,83 @@ int APEX_cpu_run(APEX_CPU *cpu) {
             printf("--------------------------------\n");
         }
 
-        if(AnyInstructionRetired == 0)
-        {
-            retireInstruction(cpu);
-            retireInstruction(cpu);
+        APEX_cpu_cycle(cpu);
+    }
 
-            AnyInstructionRetired+=2;
+    return 0;
+}
 
-            } else if(AnyInstructionRetired == 1){
-            retireInstruction(cpu);
-            AnyInstructionRetired+=1;
-        }
 
-        retireInstruction(cpu);
-        memFU(cpu);
-        AnyInstructionRetired = 0; // reset
-        intFU(cpu);
-        mulFU(cpu);
-        addToQueues(cpu);
-        decode(cpu);
-        fetch(cpu);
-        cpu->clock++;
+/*
+ * Writes the final state requested on the command line and compares
+ * memory against the expected image. Returns the number of mismatches,
+ * -1 if a file could not be read or written.
+ *
+ * The --state-dump file holds STATE_DUMP_MAGIC, then as 32-bit words the
+ * architectural register count, R0-R15 (through the B-RAT), the zero
+ * flag, URF_SIZE and the URF values, then the non-zero memory runs
+ * written by DataMemory::write_runs.
+ */
+int APEX_cpu_dump_state(APEX_CPU *cpu) {
+    int ret = 0;
+
+    // A run stopped without HALT may still buffer committed STOREs
+    drain_store_buffer(cpu, 1);
+
+    if (apex_config.mem_dump && !cpu->data_memory->dump(apex_config.mem_dump)) {
+        fprintf(stderr, "APEX_CPU : Cannot write %s\n", apex_config.mem_dump);
+        ret = -1;
     }
 
-    return 0;
-}
+    if (apex_config.state_dump) {
+        FILE *fp = fopen(apex_config.state_dump, "wb");
+        if (fp) {
+            int header[2] = {NUM_ARCH_REGISTERS, 0};
+            fwrite(STATE_DUMP_MAGIC, 1, 8, fp);
+            fwrite(header, sizeof(int), 1, fp);
+            for (int i = 0; i < NUM_ARCH_REGISTERS; i++) {
+                int reg = cpu->urf->B_RAT[i];
+                int value = reg >= 0 ? cpu->urf->URF_Table[reg] : 0;
+                fwrite(&value, sizeof(int), 1, fp);
+            }
+            fwrite(&cpu->zero_flag, sizeof(int), 1, fp);
+            header[1] = URF_SIZE;
+            fwrite(&header[1], sizeof(int), 1, fp);
+            fwrite(cpu->urf->URF_Table, sizeof(int), URF_SIZE, fp);
+            cpu->data_memory->write_runs(fp);
+        }
+        if (!fp || fclose(fp) != 0) {
+            fprintf(stderr, "APEX_CPU : Cannot write %s\n",
+                    apex_config.state_dump);
+            ret = -1;
+        }
+    }
 
+    if (apex_config.expect_image) {
+        printf("\n\n============== MEMORY VS %s =============\n\n",
+               apex_config.expect_image);
+        long mismatches = cpu->data_memory->diff(apex_config.expect_image,
+                                                 MAX_REPORTED_MISMATCHES);
+        if (mismatches < 0) {
+            fprintf(stderr, "APEX_CPU : Cannot read %s\n",
+                    apex_config.expect_image);
+            ret = -1;
+        } else if (mismatches == 0) {
+            printf("Memory matches the expected image\n");
+        } else {
+            printf("%ld words differ from the expected image\n", mismatches);
+            if (ret == 0)
+                ret = (int) mismatches;
+        }
+    }
+    return ret;
+}
 
-void simulate(APEX_CPU* cpu)
+/*
+ * Prints the end-of-run report and writes the final state dumps. Returns
+ * the APEX_cpu_dump_state result so the caller can exit non-zero.
+ */
+int simulate(APEX_CPU* cpu)
 {
     // STATE OF ARCHITECTURAL REGISTER FILE
     printf("\n");
@@ -1538,8 +3211,115 @@ void simulate(APEX_CPU* cpu)
     // STATE OF DATA MEMORY
     printf("\n\n============== STATE OF DATA MEMORY =============\n\n");
     for (int i = 0; i < 15; i++) {
-        printf("|\tMEM[%d]\t|\tData Value = %d\t|\n", i, cpu->data_memory[i]);
+        printf("|\tMEM[%d]\t|\tData Value = %d\t|\n", i,
+               cpu->data_memory->peek(i));
+    }
+    printf("\n%d data pages (%d KB) allocated\n",
+           cpu->data_memory->page_count(),
+           cpu->data_memory->page_count() * PAGE_WORDS * 4 / 1024);
+    if (cpu->data_memory->faults > 0)
+        printf("%ld memory faults, first at pc(%d) on MEM[%d]\n",
+               cpu->data_memory->faults, cpu->data_memory->fault_pc,
+               cpu->data_memory->fault_address);
+
+    // REGION OF INTEREST
+    int roi_end_clock = cpu->roi_state == ROI_DONE ? cpu->roi_end_clock
+                                                   : cpu->clock;
+    int roi_end_retired = cpu->roi_state == ROI_DONE ? cpu->roi_end_retired
+                                                     : cpu->ins_completed;
+    if (cpu->roi_state == ROI_WARMUP) {
+        printf("\nRegion of interest never started, statistics are empty\n");
+    } else if (cpu->roi_begin_clock > 0 || cpu->roi_state == ROI_DONE) {
+        int cycles = roi_end_clock - cpu->roi_begin_clock;
+        int retired = roi_end_retired - cpu->roi_begin_retired;
+        printf("\nRegion of interest: cycles %d-%d, %d cycles, %d instructions, "
+               "IPC %.3f\n", cpu->roi_begin_clock, roi_end_clock, cycles,
+               retired, cycles ? (double) retired / cycles : 0.0);
     }
+
+    // STALL BREAKDOWN
+    cpu->stalls->print(stage_names);
+
+    // STRUCTURE OCCUPANCY
+    cpu->occupancy->print();
+
+    // REGISTER RECLAMATION
+    printf("\nURF: %.1f of %d registers free on average, %.0f renames found "
+           "none free\n", cpu->stat.urf_free->value(-1), URF_SIZE,
+           cpu->stat.urf_alloc_failures->value(-1));
+    printf("URF: %.0f freed at commit, %.0f early, %.0f by flushes\n",
+           cpu->stat.urf_freed_commit->value(-1),
+           cpu->stat.urf_freed_early->value(-1),
+           cpu->stat.urf_freed_flush->value(-1));
+
+    if (apex_config.move_elim)
+        printf("Rename: %.0f copies, %.0f constants and %.0f zero idioms "
+               "eliminated, %.0f sharing a register\n",
+               cpu->stat.elim_copies->value(-1),
+               cpu->stat.elim_constants->value(-1),
+               cpu->stat.elim_zero_idioms->value(-1),
+               cpu->stat.elim_shared->value(-1));
+
+    if (apex_config.fusion)
+        printf("Fusion: %.0f compare-and-branch pairs fused, %.0f missed for "
+               "lack of a CFID\n", cpu->stat.fusion_pairs->value(-1),
+               cpu->stat.fusion_missed->value(-1));
+
+    if (cpu->store_buffer)
+        printf("Store buffer (%d entries): %.1f in use on average, %.0f "
+               "STOREs coalesced, %.0f LOADs forwarded, %.0f cycles full\n",
+               apex_config.store_buffer, cpu->stat.sb_occupancy->value(-1),
+               cpu->stat.sb_coalesced->value(-1),
+               cpu->stat.sb_forwarded->value(-1),
+               cpu->stat.sb_full->value(-1));
+
+    if (apex_config.mem_dep)
+        printf("Memory dependences (%s): %.0f LOADs ahead of the LSQ head, "
+               "%.0f held, %.0f violations avoided, %.0f suffered\n",
+               apex_config.mem_dep == 1 ? "store sets" : "no prediction",
+               cpu->stat.early_loads->value(-1),
+               cpu->stat.held_loads->value(-1),
+               cpu->stat.violations_avoided->value(-1),
+               cpu->stat.violations->value(-1));
+
+    if (cpu->value_pred)
+        printf("Value prediction (%s): %.0f of %.0f LOADs predicted, %.0f "
+               "correct, %.0f replayed\n",
+               apex_config.value_pred == VP_STRIDE ? "stride" : "last value",
+               cpu->stat.vp_predictions->value(-1),
+               cpu->stat.vp_loads->value(-1), cpu->stat.vp_correct->value(-1),
+               cpu->stat.vp_mispredicts->value(-1));
+
+    // COMMIT BANDWIDTH
+    printf("\nCommit width %d: %.2f instructions per cycle, %.0f cycles "
+           "limited by commit width\n", apex_config.commit_width,
+           cpu->stat.committed->value(-1),
+           cpu->stat.commit_width_limited->value(-1));
+
+    // INSTRUCTION LIFECYCLE
+    cpu->lifecycle->print(10);
+
+    // BRANCH STATISTICS
+    cpu->branch_stats->print();
+    if (!cpu->branch_stats->write_csv(BRANCH_STATS_FILE))
+        fprintf(stderr, "APEX_CPU : Unable to write %s\n", BRANCH_STATS_FILE);
+
+    // EXECUTION PROFILE
+    cpu->profile->print(cpu->code_memory, cpu->code_memory_size, 10);
+    if (!cpu->profile->write_csv(PC_PROFILE_FILE, cpu->code_memory,
+                                 cpu->code_memory_size))
+        fprintf(stderr, "APEX_CPU : Unable to write %s\n", PC_PROFILE_FILE);
+
+    // STATISTICS REGISTRY
+    cpu->stats->dump(cpu->clock);
+
+    // CO-SIMULATION
+    if (cpu->golden)
+        printf("\nCo-simulation: %ld commits matched the golden model\n",
+               cpu->golden->committed);
+
+    // FINAL STATE DUMPS
+    return APEX_cpu_dump_state(cpu);
 }
 
 
@@ -1549,8 +3329,7 @@ APEX_cpu_run_for_cycles(APEX_CPU* cpu, int iNoOfCycles, int iAction) {
 
         if(isHalt || (cpu->clock == iNoOfCycles))
         {
-            simulate(cpu);
-            break;
+            return simulate(cpu);
         }
 
 
@@ -1561,29 +3340,31 @@ APEX_cpu_run_for_cycles(APEX_CPU* cpu, int iNoOfCycles, int iAction) {
             printf("\n");
         }
 
-
-        if(AnyInstructionRetired == 0)
-        {
-            retireInstruction(cpu);
-            retireInstruction(cpu);
-
-            AnyInstructionRetired+=2;
-
-        } else if(AnyInstructionRetired == 1){
-            retireInstruction(cpu);
-            AnyInstructionRetired+=1;
-        }
-
-        memFU(cpu);
-        AnyInstructionRetired = 0; // reset
-        intFU(cpu);
-        mulFU(cpu);
-        addToQueues(cpu);
-        decode(cpu);
-        fetch(cpu);
-        cpu->clock++;
+        APEX_cpu_cycle(cpu);
     }
 
     return 0;
 }
 
+/*
+ * Simulates one clock cycle. Returns 1 once HALT has committed.
+ */
+int
+APEX_cpu_cycle(APEX_CPU* cpu) {
+    cpu->stalls->begin_cycle();
+    trace_latches(cpu);
+
+    TIMED_STAGE(SF_RETIRE, commit(cpu));
+    TIMED_STAGE(SF_MEM, memFU(cpu));
+    TIMED_STAGE(SF_INT, intFU(cpu));
+    TIMED_STAGE(SF_MUL, mulFU(cpu));
+    TIMED_STAGE(SF_QUEUE, addToQueues(cpu));
+    TIMED_STAGE(SF_DECODE, decode(cpu));
+    TIMED_STAGE(SF_FETCH, fetch(cpu));
+    sample_occupancy(cpu);
+    count_cycle(cpu);
+    cpu->stalls->end_cycle();
+    cpu->clock++;
+    return isHalt == TRUE;
+}
+
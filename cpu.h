@@ -5,9 +5,25 @@
 #include "URF.h"
 #include "LSQ.h"
 #include "BTB.h"
+#include "InstrWindow.h"
+#include "FreeList.h"
+#include "ValuePredictor.h"
+#include "StoreSets.h"
+#include "StoreBuffer.h"
+#include "BranchStats.h"
+#include "StallStats.h"
+#include "OccupancyStats.h"
+#include "LifecycleStats.h"
+#include "PcProfile.h"
+#include "StatRegistry.h"
+#include "KanataLog.h"
+#include "DataMemory.h"
+#include "config.h"
 #include "helper.h"
 #include <map>
 
+class GoldenModel;
+
 /**
  *  cpu.h
  *  Contains various CPU and Pipeline Data structures
@@ -25,15 +41,54 @@ enum {
 	INT_FU, MUL_FU, LS_FU
 };
 
+/* Region of interest, statistics only cover ROI_ACTIVE */
+enum {
+	ROI_WARMUP, ROI_ACTIVE, ROI_DONE
+};
+
+/* Stage functions of one cycle, in the order the run loop calls them */
+enum {
+	SF_RETIRE, SF_MEM, SF_INT, SF_MUL, SF_QUEUE, SF_DECODE, SF_FETCH,
+	NUM_STAGE_FUNCTIONS
+};
+
+/* Host seconds spent in each stage function, only counted in builds
+ * with APEX_STAGE_TIMING defined and while apex_stage_timing is set */
+extern double apex_stage_seconds[NUM_STAGE_FUNCTIONS];
+extern int apex_stage_timing;
+extern const char* const stage_function_names[NUM_STAGE_FUNCTIONS];
+
+/* Architectural registers R0-R15 */
+#define NUM_ARCH_REGISTERS 16
+
+/* Opcodes, in the order of the parser's format table */
+enum APEX_Opcode {
+	OP_MOVC, OP_STORE, OP_LOAD, OP_JAL, OP_ADD, OP_ADDL, OP_SUB, OP_SUBL,
+	OP_MUL, OP_AND, OP_OR, OP_EXOR, OP_BZ, OP_BNZ, OP_JUMP, OP_HALT, OP_NOP,
+	OP_ROI_BEGIN, OP_ROI_END,
+	NUM_OPCODES
+};
+
 /* Format of an APEX instruction  */
 typedef struct APEX_Instruction {
 	char opcode[128];	// Operation Code
+	int op;			// APEX_Opcode of opcode
 	int rd;		    // Destination Register Address
 	int rs1;		    // Source-1 Register Address
 	int rs2;		    // Source-2 Register Address
 	int imm;		    // Literal Value
 } APEX_Instruction;
 
+/* Metadata of an instruction decoded once at load, indexed by get_code_index */
+typedef struct APEX_Decoded_Instruction {
+	int op;			// APEX_Opcode
+	int fu_type;		// INT_FU, MUL_FU or LS_FU
+	int is_control_flow;	// BZ, BNZ, JUMP or JAL, holds a CFID until retire
+	int is_mem;		// LOAD or STORE, holds an LSQ entry
+	int writes_rd;		// Maps rd in the B-RAT when it retires
+	int sets_flag;		// Sets the zero flag, renames it to its rd
+} APEX_Decoded_Instruction;
+
 typedef struct Int_BUS {
     int r;
     int r_value;
@@ -65,6 +120,7 @@ typedef struct CPU_Stage {
 	int u_rs2_valid;
 	int rd;		    // Destination Register Address
 	int u_rd;
+	int prev_u_rd;		// F-RAT mapping of rd before renaming
 	int imm;		    // Literal Value
 	int rs1_value;	// Source-1 Register Value
 	int rs2_value;	// Source-2 Register Value
@@ -75,11 +131,60 @@ typedef struct CPU_Stage {
 	int fuType;       // Function Unit Type ENUM value
 	int zeroFlag;
 	int CFID;
+	int fetch_clock;      // Cycle the instruction left Fetch
+	int rename_clock;     // Cycle the instruction left D/RF
+	int dispatch_clock;   // IQEntry::clock, set once issued to a FU
+	int seq;              // Kanata id, 0 for an empty latch
+	int trace_stage;      // Last stage reported to the Kanata log
+	int fused_cfid;       // CFID of a BZ/BNZ fused into it, 0 if none
+	int fused_seq;        // Kanata id of that branch
 } CPU_Stage;
 
 
 /*PC<-->Instruction Map*/
 
+/* Registry entries the pipeline updates, registered by APEX_cpu_init */
+typedef struct APEX_Stats {
+	Stat* cycles;
+	Stat* retired;
+	Stat* occupancy[NUM_OCC_STRUCTURES];	// Indexed by OCC_IQ...
+	Stat* full_cycles[NUM_OCC_STRUCTURES];
+	Stat* squashed_iq;
+	Stat* squashed_rob;
+	Stat* squashed_lsq;
+	Stat* btb_lookups;
+	Stat* btb_hits;
+	Stat* btb_correct;
+	Stat* mispredicts;
+	Stat* fu_issued[3];			// Indexed by INT_FU, MUL_FU, LS_FU
+	Stat* fu_busy_cycles[3];
+	Stat* committed;			// Instructions retired per cycle
+	Stat* commit_width_limited;
+	Stat* urf_free;				// Free list length per cycle
+	Stat* urf_alloc_failures;
+	Stat* urf_freed_commit;
+	Stat* urf_freed_early;
+	Stat* urf_freed_flush;
+	Stat* elim_copies;			// Move elimination at rename
+	Stat* elim_constants;
+	Stat* elim_zero_idioms;
+	Stat* elim_shared;
+	Stat* fusion_pairs;			// Macro-op fusion at decode
+	Stat* fusion_missed;
+	Stat* vp_loads;				// Load value prediction
+	Stat* vp_predictions;
+	Stat* vp_correct;
+	Stat* vp_mispredicts;
+	Stat* early_loads;			// Memory dependence prediction
+	Stat* held_loads;
+	Stat* violations;
+	Stat* violations_avoided;
+	Stat* sb_occupancy;			// Post-commit store buffer
+	Stat* sb_coalesced;
+	Stat* sb_forwarded;
+	Stat* sb_full;
+} APEX_Stats;
+
 /* Model of APEX CPU */
 typedef struct APEX_CPU {
 	/* Clock cycles elasped */
@@ -88,15 +193,15 @@ typedef struct APEX_CPU {
 	/* Current program counter */
 	int pc;
 
-	/* Array of 5 CPU_stage */
-	CPU_Stage stage[5];
+	/* Array of CPU_stage, indexed by the stage enum */
+	CPU_Stage stage[NUM_STAGES];
 
 	/* Code Memory where instructions are stored */
 	APEX_Instruction* code_memory;
 	int code_memory_size;
 
 	/* Data Memory */
-	int data_memory[4096];
+	DataMemory* data_memory;
 
 	/* Some stats */
 	int ins_completed;
@@ -116,11 +221,60 @@ typedef struct APEX_CPU {
 	/*BTS / BTB*/
 	BTB* btb;
 
+	/* URF registers available to the renamer */
+	FreeList* free_list;
+
 	/*ZERO FLAG*/
 	int zero_flag;
 
+	/* URF register of the youngest in-flight flag setter, whose value the
+	 * next BZ/BNZ tests; -1 reads the committed zero_flag */
+	int flag_reg;
+
+	/* Load value predictor, NULL unless --value-pred is given */
+	ValuePredictor* value_pred;
+
+	/* Memory dependence predictor, NULL unless --mem-dep=1 */
+	StoreSets* store_sets;
+
+	/* Committed STOREs not written yet, NULL unless --store-buffer is given */
+	StoreBuffer* store_buffer;
+
+	/* In-flight instructions in ROB order */
+	InstrWindow* window;
+
+	/* Per branch-PC statistics */
+	BranchStats* branch_stats;
 
-	map<int,APEX_Instruction*> *imap;
+	/* Per-cycle stall attribution */
+	StallStats* stalls;
+
+	/* Per-cycle IQ/ROB/LSQ/URF/CFID occupancy */
+	OccupancyStats* occupancy;
+
+	/* Per-opcode phase latencies and dependence chains */
+	LifecycleStats* lifecycle;
+
+	/* Per-pc fetch/issue/squash/retire counts and ROB head stalls */
+	PcProfile* profile;
+
+	/* Named statistics exported by --stats-json/--stats-csv */
+	StatRegistry* stats;
+	APEX_Stats stat;
+
+	/* Region of interest, from ROI_BEGIN/ROI_END or --warmup-* / --roi-insns */
+	int roi_state;
+	int roi_begin_clock;
+	int roi_begin_retired;
+	int roi_end_clock;
+	int roi_end_retired;
+
+	KanataLog* kanata;			// NULL unless --kanata is given
+	int next_seq;
+
+
+	APEX_Decoded_Instruction* itable;	// One entry per code_memory slot
+	GoldenModel* golden;			// Co-simulation reference, NULL if disabled
 
 	Int_Bus int_bus;
 	Mul_Bus mul_bus;
@@ -132,6 +286,12 @@ typedef struct APEX_CPU {
 APEX_Instruction*
 create_code_memory(const char* filename, int* size);
 
+const char*
+APEX_opcode_name(int op);
+
+int
+get_code_index(int pc);
+
 APEX_CPU*
 APEX_cpu_init(const char* filename);
 
@@ -140,9 +300,18 @@ APEX_cpu_run(APEX_CPU* cpu);
 
 int APEX_cpu_run_for_cycles(APEX_CPU* cpu, int cycles, int action);
 
+int
+APEX_cpu_cycle(APEX_CPU* cpu);
+
 void
 APEX_cpu_stop(APEX_CPU* cpu);
 
+void
+APEX_cpu_reset_stats(APEX_CPU* cpu);
+
+int
+APEX_cpu_dump_state(APEX_CPU* cpu);
+
 int
 fetch(APEX_CPU* cpu);
 
@@ -7,129 +7,235 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "cpu.h"
 #include "helper.h"
 
-/*
- * This function is related to parsing input file
- *
- * Note : You are not supposed to edit this function
- */
-static int get_num_from_string(char* buffer) {
-	char str[16];
-	int j = 0;
-	for (int i = 1; buffer[i] != '\0'; ++i) {
-		str[j] = buffer[i];
-		j++;
+#define INITIAL_CODE_MEMORY_SIZE 1024
+
+/* Instruction fields an operand is stored into */
+enum {
+	FIELD_NONE, FIELD_RD, FIELD_RS1, FIELD_RS2, FIELD_IMM
+};
+
+typedef struct Instruction_Format {
+	int op;
+	const char* opcode;
+	int fields[3];		// Operand fields in source order
+} Instruction_Format;
+
+static const Instruction_Format formats[] = {
+	{ OP_MOVC,  "MOVC",  { FIELD_RD,  FIELD_IMM, FIELD_NONE } },
+	{ OP_STORE, "STORE", { FIELD_RS1, FIELD_RS2, FIELD_IMM } },
+	{ OP_LOAD,  "LOAD",  { FIELD_RD,  FIELD_RS1, FIELD_IMM } },
+	{ OP_JAL,   "JAL",   { FIELD_RD,  FIELD_RS1, FIELD_IMM } },
+	{ OP_ADD,   "ADD",   { FIELD_RD,  FIELD_RS1, FIELD_RS2 } },
+	{ OP_ADDL,  "ADDL",  { FIELD_RD,  FIELD_RS1, FIELD_IMM } },
+	{ OP_SUB,   "SUB",   { FIELD_RD,  FIELD_RS1, FIELD_RS2 } },
+	{ OP_SUBL,  "SUBL",  { FIELD_RD,  FIELD_RS1, FIELD_IMM } },
+	{ OP_MUL,   "MUL",   { FIELD_RD,  FIELD_RS1, FIELD_RS2 } },
+	{ OP_AND,   "AND",   { FIELD_RD,  FIELD_RS1, FIELD_RS2 } },
+	{ OP_OR,    "OR",    { FIELD_RD,  FIELD_RS1, FIELD_RS2 } },
+	{ OP_EXOR,  "EX-OR", { FIELD_RD,  FIELD_RS1, FIELD_RS2 } },
+	{ OP_BZ,    "BZ",    { FIELD_IMM, FIELD_NONE, FIELD_NONE } },
+	{ OP_BNZ,   "BNZ",   { FIELD_IMM, FIELD_NONE, FIELD_NONE } },
+	{ OP_JUMP,  "JUMP",  { FIELD_RS1, FIELD_IMM, FIELD_NONE } },
+	{ OP_HALT,  "HALT",  { FIELD_NONE, FIELD_NONE, FIELD_NONE } },
+	{ OP_NOP,   "NOP",   { FIELD_NONE, FIELD_NONE, FIELD_NONE } },
+	{ OP_ROI_BEGIN, "ROI_BEGIN", { FIELD_NONE, FIELD_NONE, FIELD_NONE } },
+	{ OP_ROI_END,   "ROI_END",   { FIELD_NONE, FIELD_NONE, FIELD_NONE } },
+};
+
+const char*
+APEX_opcode_name(int op) {
+	if (op < 0 || op >= NUM_OPCODES)
+		return "";
+	return formats[op].opcode;
+}
+
+static int is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const Instruction_Format*
+find_format(const char* begin, const char* end) {
+	size_t len = end - begin;
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+		if (strlen(formats[i].opcode) == len
+				&& memcmp(formats[i].opcode, begin, len) == 0) {
+			return &formats[i];
+		}
 	}
-	str[j] = '\0';
-	return atoi(str);
+	return NULL;
 }
 
 /*
- * This function is related to parsing input file
+ * Parses one "R<n>" or "#<n>" operand in [p, end) up to the next ',' or
+ * the end of the line. Returns a pointer past the operand, NULL if it is
+ * malformed: a register outside R0-R15 or a literal that does not fit
+ * in an int.
  */
-static void create_APEX_instruction(APEX_Instruction* ins, char* buffer) {
-	char* token = strtok(buffer, ",");
-	int token_num = 0;
-	char tokens[6][128];
-	while (token != NULL) {
-		strcpy(tokens[token_num], token);
-		token_num++;
-		token = strtok(NULL, ",");
-	}
-
-	strcpy(ins->opcode, tokens[0]);
-
-	if (strcmp(ins->opcode, "MOVC") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->imm = get_num_from_string(tokens[2]);
-	}
+static const char*
+parse_operand(const char* p, const char* end, int field, int* value) {
+	while (p < end && is_space(*p))
+		p++;
+	if (p == end)
+		return NULL;
 
-	if (strcmp(ins->opcode, "STORE") == 0) {
-		ins->rs1 = get_num_from_string(tokens[1]);
-		ins->rs2 = get_num_from_string(tokens[2]);
-		ins->imm = get_num_from_string(tokens[3]);
-	}
+	char prefix = (field == FIELD_IMM) ? '#' : 'R';
+	if (*p != prefix && !(prefix == 'R' && *p == 'r'))
+		return NULL;
+	p++;
 
-	if (strcmp(ins->opcode, "LOAD") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->imm = get_num_from_string(tokens[3]);
+	int negative = 0;
+	// Register numbers carry no sign
+	if (field == FIELD_IMM && p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
 	}
+	if (p == end || *p < '0' || *p > '9')
+		return NULL;
 
-	if (strcmp(ins->opcode, "JAL") == 0) {
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->imm = get_num_from_string(tokens[3]);
+	long num = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		num = num * 10 + (*p - '0');
+		if (num > 2147483648L)
+			return NULL;
+		p++;
 	}
+	if (field != FIELD_IMM && num >= NUM_ARCH_REGISTERS)
+		return NULL;
+	if (!negative && num > 2147483647L)
+		return NULL;
+	*value = (int) (negative ? -num : num);
 
-	if (strcmp(ins->opcode, "ADD") == 0) {
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-	}
-	if (strcmp(ins->opcode, "ADDL") == 0) {
-		ins->imm = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-	}
+	while (p < end && is_space(*p))
+		p++;
+	return p;
+}
 
-	if (strcmp(ins->opcode, "SUB") == 0) {
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-	}
+/*
+ * Parses the instruction in [begin, end), without the newline.
+ * Returns 0 if the line is malformed.
+ */
+static int create_APEX_instruction(APEX_Instruction* ins, const char* begin,
+		const char* end) {
+	const char* p = begin;
+	while (p < end && *p != ',')
+		p++;
+	const char* op_end = p;
+	while (op_end > begin && is_space(op_end[-1]))
+		op_end--;
+	while (begin < op_end && is_space(*begin))
+		begin++;
 
-	if (strcmp(ins->opcode, "SUBL") == 0) {
-		ins->imm = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-	}
+	const Instruction_Format* format = find_format(begin, op_end);
+	if (!format)
+		return 0;
 
-	if (strcmp(ins->opcode, "MUL") == 0) {
-		ins->rs1 = get_num_from_string(tokens[2]);
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-	}
+	memcpy(ins->opcode, begin, op_end - begin);
+	ins->opcode[op_end - begin] = '\0';
+	ins->op = format->op;
+	ins->rd = 0;
+	ins->rs1 = 0;
+	ins->rs2 = 0;
+	ins->imm = 0;
 
-	if (strcmp(ins->opcode, "AND") == 0) {
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
+	for (int i = 0; i < 3 && format->fields[i] != FIELD_NONE; ++i) {
+		if (p == end || *p != ',')
+			return 0;
+		int value;
+		p = parse_operand(p + 1, end, format->fields[i], &value);
+		if (!p)
+			return 0;
+		switch (format->fields[i]) {
+		case FIELD_RD:
+			ins->rd = value;
+			break;
+		case FIELD_RS1:
+			ins->rs1 = value;
+			break;
+		case FIELD_RS2:
+			ins->rs2 = value;
+			break;
+		case FIELD_IMM:
+			ins->imm = value;
+			break;
+		}
 	}
+	return p == end;
+}
 
-	if (strcmp(ins->opcode, "OR") == 0) {
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-	}
+/*
+ * Parses the whole program in one pass over the mapped file. Blank and
+ * comment-only lines are skipped, any other line that is not a valid instruction is reported
+ * with its line number and fails the load.
+ */
+static APEX_Instruction*
+parse_code(const char* filename, const char* data, size_t length, int* size) {
+	int capacity = INITIAL_CODE_MEMORY_SIZE;
+	int count = 0;
+	APEX_Instruction* code_memory = (APEX_Instruction*) malloc(
+			sizeof(*code_memory) * capacity);
+	if (!code_memory)
+		return NULL;
 
-	if (strcmp(ins->opcode, "EX-OR") == 0) {
-		ins->rs2 = get_num_from_string(tokens[3]);
-		ins->rd = get_num_from_string(tokens[1]);
-		ins->rs1 = get_num_from_string(tokens[2]);
-	}
+	const char* p = data;
+	const char* end = data + length;
+	int line_number = 0;
+	while (p < end) {
+		const char* eol = (const char*) memchr(p, '\n', end - p);
+		if (!eol)
+			eol = end;
+		line_number++;
 
-	if (strcmp(ins->opcode, "BZ") == 0) {
-		ins->imm = get_num_from_string(tokens[1]);
-	}
+		// ';' starts a comment running to the end of the line
+		const char* line_end = (const char*) memchr(p, ';', eol - p);
+		if (!line_end)
+			line_end = eol;
+		while (line_end > p && is_space(line_end[-1]))
+			line_end--;
+		const char* q = p;
+		while (q < line_end && is_space(*q))
+			q++;
 
-	if (strcmp(ins->opcode, "JUMP") == 0) {
-		ins->rs1 = get_num_from_string(tokens[1]);
-		ins->imm = get_num_from_string(tokens[2]);
+		if (q < line_end) {
+			if (count == capacity) {
+				capacity *= 2;
+				APEX_Instruction* grown = (APEX_Instruction*) realloc(
+						code_memory, sizeof(*code_memory) * capacity);
+				if (!grown) {
+					free(code_memory);
+					return NULL;
+				}
+				code_memory = grown;
+			}
+			if (!create_APEX_instruction(&code_memory[count], q, line_end)) {
+				fprintf(stderr,
+						"APEX_CPU : %s:%d: malformed instruction \"%.*s\"\n",
+						filename, line_number, (int) (line_end - q), q);
+				free(code_memory);
+				return NULL;
+			}
+			count++;
+		}
+		p = eol + 1;
 	}
 
-	if (strcmp(ins->opcode, "BNZ") == 0) {
-		ins->imm = get_num_from_string(tokens[1]);
+	*size = count;
+	if (!count) {
+		free(code_memory);
+		return NULL;
 	}
+	return code_memory;
 }
 
 /*
- * This function is related to parsing input file
- *
- * Note : You are not supposed to edit this function
+ * Maps the input file and parses it into code memory
  */
 APEX_Instruction*
 create_code_memory(const char* filename, int* size) {
@@ -137,40 +243,27 @@ create_code_memory(const char* filename, int* size) {
 		return NULL;
 	}
 
-	FILE* fp = fopen(filename, "r");
-	if (!fp) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
 		return NULL;
 	}
 
-	char* line = NULL;
-	size_t len = 0;
-	ssize_t nread;
-	int code_memory_size = 0;
-
-	while ((nread = getline(&line, &len, fp)) != -1) {
-		code_memory_size++;
-	}
-	*size = code_memory_size;
-	if (!code_memory_size) {
-		fclose(fp);
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		*size = 0;
+		close(fd);
 		return NULL;
 	}
 
-	APEX_Instruction* code_memory = (APEX_Instruction*) malloc(
-			sizeof(*code_memory) * code_memory_size);
-	if (!code_memory) {
-		fclose(fp);
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
 		return NULL;
 	}
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
 
-	rewind(fp);
-	int current_instruction = 0;
-	while ((nread = getline(&line, &len, fp)) != -1) {
-		create_APEX_instruction(&code_memory[current_instruction], line);
-		current_instruction++;
-	}
-
-	free(line);
-	fclose(fp);
+	APEX_Instruction* code_memory = parse_code(filename, (const char*) data,
+			st.st_size, size);
+	munmap(data, st.st_size);
 	return code_memory;
 }
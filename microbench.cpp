@@ -0,0 +1,373 @@
+/*
+ *  microbench.cpp
+ *  Microbenchmarks of the per-cycle operations of the out-of-order
+ *  structures: IQ select/wakeup/flush, ROB dispatch/retire/flush, LSQ
+ *  dispatch/flush, URF allocation and snapshots and BTB CFID handling,
+ *  each at occupancies from 8 to 256 entries.
+ *
+ *  usage: apex_microbench [--batch=N] [--repeat=N] [--json=FILE]
+ *
+ *  IQ, ROB, LSQ and URF capacities are fixed by IQ_SIZE, ROB_SIZE, LSQ_SIZE
+ *  and URF_SIZE in helper.h, occupancies above them are reported as "-".
+ *  Rebuild with larger sizes to measure them. The BTB is sized at run time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "helper.h"
+#include "IQ.h"
+#include "ROB.h"
+#include "LSQ.h"
+#include "URF.h"
+#include "BTB.h"
+
+using namespace std;
+
+static const int occupancies[] = {8, 16, 32, 64, 128, 256};
+#define NUM_OCCUPANCIES ((int) (sizeof(occupancies) / sizeof(occupancies[0])))
+
+struct Micro_Result {
+    const char *structure;
+    const char *operation;
+    int capacity;
+    double ns[NUM_OCCUPANCIES];     // Per operation, < 0 when not measured
+};
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Keeps results of the timed calls alive */
+static volatile long sink;
+
+/*
+ * Times one call of 'op' on each of 'batch' instances built by 'make' for
+ * size n and brought to occupancy n by 'prepare'. Building and destroying
+ * the instances is not timed, so every call sees the same state. Returns
+ * the best ns/op over 'repeat' rounds.
+ */
+template<class T, class Make, class Prepare, class Op>
+static double time_op(int n, int batch, int repeat, Make make,
+                      Prepare prepare, Op op) {
+    double best = -1;
+    vector<T *> instances(batch);
+    for (int r = 0; r < repeat; r++) {
+        for (int i = 0; i < batch; i++) {
+            instances[i] = make(n);
+            prepare(instances[i], n);
+        }
+        double start = now();
+        for (int i = 0; i < batch; i++)
+            op(instances[i], n);
+        double ns = (now() - start) * 1e9 / batch;
+        for (int i = 0; i < batch; i++)
+            delete instances[i];
+        if (best < 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+/* Integer op of branch group 'cfid' at 'pc', ready unless 'wait_tag' >= 0 */
+static IQEntry make_iq_entry(int pc, int cfid, int wait_tag) {
+    IQEntry entry;
+    entry.pc = pc;
+    entry.fuType = INT_FU;
+    entry.src1 = wait_tag >= 0 ? wait_tag : 0;
+    entry.src1Value = 0;
+    entry.src1Valid = wait_tag < 0;
+    entry.src2 = -1;
+    entry.src2Value = -1;
+    entry.src2Valid = -1;
+    entry.rd = 0;
+    entry.literal = 0;
+    entry.clock = pc;
+    entry.CFID = cfid;
+    entry.lsqIndex = -1;
+    strcpy(entry.opcode, "ADD");
+    if (entry.src1Valid)
+        entry.setStatus();
+    return entry;
+}
+
+static void fill_iq(IQ *iq, int n, int wait_tag) {
+    for (int i = 0; i < n; i++) {
+        IQEntry entry = make_iq_entry(4000 + 4 * i, 1 + i % CFID_SIZE,
+                                      wait_tag);
+        iq->addToIssueQueue(&entry, INT_FU);
+    }
+}
+
+static Rob_entry make_rob_entry(int pc, int cfid) {
+    Rob_entry rob_entry;
+    rob_entry.setStatus(VALID);
+    rob_entry.setPc_value(pc);
+    rob_entry.setExcodes(-1);
+    rob_entry.setResult(0);
+    rob_entry.setArchiteture_register(1);
+    rob_entry.setM_unifier_register(1);
+    rob_entry.setCFID(cfid);
+    return rob_entry;
+}
+
+static void fill_rob(ROB *rob, int n) {
+    for (int i = 0; i < n; i++)
+        rob->add_instruction_to_ROB(make_rob_entry(4000 + 4 * i,
+                                                   1 + i % CFID_SIZE));
+}
+
+static LSQ_entry make_lsq_entry(int pc, int cfid) {
+    LSQ_entry lsq_entry;
+    lsq_entry.setM_pc(pc);
+    lsq_entry.setM_status(0);
+    lsq_entry.allocated = UNALLOCATED;
+    lsq_entry.setM_which_ins(LOAD);
+    lsq_entry.setM_memory_addr(-1);
+    lsq_entry.setM_is_memory_addr_valid(INVALID);
+    lsq_entry.setM_dest_reg(1);
+    lsq_entry.setM_store_reg(-1);
+    lsq_entry.setM_store_src1_data_valid(INVALID);
+    lsq_entry.setM_store_reg_value(0);
+    lsq_entry.CFID = cfid;
+    return lsq_entry;
+}
+
+static void fill_lsq(LSQ *lsq, int n) {
+    for (int i = 0; i < n; i++)
+        lsq->add_instruction_to_LSQ(make_lsq_entry(4000 + 4 * i,
+                                                   1 + i % CFID_SIZE));
+}
+
+/* CFIDs 1..n of a BTB of n entries in flight, each with a prediction */
+static void fill_btb(BTB *btb, int n) {
+    for (int i = 0; i < n; i++) {
+        int cfid = btb->get_next_free_CFID();
+        btb->add_cfid(cfid);
+        btb->update_prediction(cfid, 4000 + 4 * i, 1);
+    }
+}
+
+/*
+ * flush_ROB_entries takes the CPU to release what the squashed entries
+ * hold, the ROB flush benchmark shares one CPU shell around the ROBs.
+ */
+static APEX_CPU *shell_cpu;
+
+static APEX_CPU *make_shell_cpu() {
+    APEX_CPU *cpu = (APEX_CPU *) calloc(1, sizeof(APEX_CPU));
+    cpu->iq = new IQ();
+    cpu->lsq = new LSQ();
+    cpu->urf = new URF();
+    cpu->btb = new BTB();
+    return cpu;
+}
+
+static void free_shell_cpu(APEX_CPU *cpu) {
+    delete cpu->iq;
+    delete cpu->lsq;
+    delete cpu->urf;
+    delete cpu->btb;
+    free(cpu);
+}
+
+struct Micro_Options {
+    int batch;
+    int repeat;
+};
+
+/*
+ * Runs 'op' at every occupancy up to 'capacity' and appends the row.
+ * Capacity 0 means the structure is sized by the occupancy itself.
+ */
+template<class T, class Make, class Prepare, class Op>
+static void measure(vector<Micro_Result> *results, const Micro_Options &opt,
+                    const char *structure, const char *operation,
+                    int capacity, Make make, Prepare prepare, Op op) {
+    Micro_Result result;
+    result.structure = structure;
+    result.operation = operation;
+    result.capacity = capacity;
+    for (int i = 0; i < NUM_OCCUPANCIES; i++) {
+        int n = occupancies[i];
+        result.ns[i] = capacity && n > capacity ? -1
+                : time_op<T>(n, opt.batch, opt.repeat, make, prepare, op);
+    }
+    results->push_back(result);
+}
+
+static void run_suite(vector<Micro_Result> *results, const Micro_Options &opt) {
+    auto new_iq = [](int) { return new IQ(); };
+    measure<IQ>(results, opt, "IQ", "dispatch", IQ_SIZE, new_iq,
+                [](IQ *iq, int n) { fill_iq(iq, n - 1, -1); },
+                [](IQ *iq, int n) {
+                    IQEntry entry = make_iq_entry(8000, 1, -1);
+                    sink += iq->addToIssueQueue(&entry, INT_FU);
+                });
+    measure<IQ>(results, opt, "IQ", "select", IQ_SIZE, new_iq,
+                [](IQ *iq, int n) { fill_iq(iq, n, -1); },
+                [](IQ *iq, int n) {
+                    sink += iq->getNextInstructionToIssue(INT_FU).pc;
+                });
+    measure<IQ>(results, opt, "IQ", "wakeup", IQ_SIZE, new_iq,
+                [](IQ *iq, int n) { fill_iq(iq, n, 1); },
+                [](IQ *iq, int n) { iq->updateIssueQueueEntries(1, 42); });
+    measure<IQ>(results, opt, "IQ", "flush", IQ_SIZE, new_iq,
+                [](IQ *iq, int n) { fill_iq(iq, n, -1); },
+                [](IQ *iq, int n) { iq->flushIQEntries(1, 4000); });
+
+    auto new_rob = [](int) { return new ROB(); };
+    measure<ROB>(results, opt, "ROB", "dispatch", ROB_SIZE, new_rob,
+                 [](ROB *rob, int n) { fill_rob(rob, n - 1); },
+                 [](ROB *rob, int n) {
+                     sink += rob->add_instruction_to_ROB(make_rob_entry(8000, 1));
+                 });
+    measure<ROB>(results, opt, "ROB", "retire", ROB_SIZE, new_rob,
+                 [](ROB *rob, int n) { fill_rob(rob, n); },
+                 [](ROB *rob, int n) { rob->retire_instruction_from_ROB(); });
+    measure<ROB>(results, opt, "ROB", "flush", ROB_SIZE, new_rob,
+                 [](ROB *rob, int n) { fill_rob(rob, n); },
+                 [](ROB *rob, int n) {
+                     shell_cpu->rob = rob;
+                     rob->flush_ROB_entries(rob->head, shell_cpu);
+                 });
+
+    auto new_lsq = [](int) { return new LSQ(); };
+    measure<LSQ>(results, opt, "LSQ", "dispatch", LSQ_SIZE, new_lsq,
+                 [](LSQ *lsq, int n) { fill_lsq(lsq, n - 1); },
+                 [](LSQ *lsq, int n) {
+                     sink += lsq->add_instruction_to_LSQ(make_lsq_entry(8000, 1));
+                 });
+    measure<LSQ>(results, opt, "LSQ", "flush", LSQ_SIZE, new_lsq,
+                 [](LSQ *lsq, int n) { fill_lsq(lsq, n); },
+                 [](LSQ *lsq, int n) { lsq->flushLSQEntries(1); });
+
+    auto new_urf = [](int) { return new URF(); };
+    measure<URF>(results, opt, "URF", "allocate", URF_SIZE, new_urf,
+                 [](URF *urf, int n) {
+                     for (int i = 0; i < n - 1; i++)
+                         urf->get_next_free_register();
+                 },
+                 [](URF *urf, int n) { sink += urf->get_next_free_register(); });
+    // Snapshots are owned by the ROB entries they are attached to and never
+    // freed by the simulator, the benchmark leaks them the same way
+    measure<URF>(results, opt, "URF", "snapshot", URF_SIZE, new_urf,
+                 [](URF *urf, int n) {
+                     for (int i = 0; i < n; i++)
+                         urf->get_next_free_register();
+                 },
+                 [](URF *urf, int n) { sink += (long) urf->takeSnapshot(1); });
+
+    auto new_btb = [](int n) { return new BTB(n); };
+    measure<BTB>(results, opt, "BTB", "allocate", 0,
+                 new_btb,
+                 [](BTB *btb, int n) { fill_btb(btb, n - 1); },
+                 [](BTB *btb, int n) {
+                     int cfid = btb->get_next_free_CFID();
+                     sink += btb->add_cfid(cfid);
+                 });
+    // The youngest CFID is released last, so the whole order list is searched
+    measure<BTB>(results, opt, "BTB", "release", 0,
+                 new_btb,
+                 [](BTB *btb, int n) { fill_btb(btb, n); },
+                 [](BTB *btb, int n) { sink += btb->add_CFID_to_free_list(n); });
+    measure<BTB>(results, opt, "BTB", "lookup", 0,
+                 new_btb,
+                 [](BTB *btb, int n) { fill_btb(btb, n); },
+                 [](BTB *btb, int n) { sink += btb->get_last_prediction(4); });
+}
+
+static void write_json(FILE *fp, const Micro_Options &opt,
+                       const vector<Micro_Result> &results) {
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"batch\": %d,\n", opt.batch);
+    fprintf(fp, "  \"repeat\": %d,\n", opt.repeat);
+    fprintf(fp, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Micro_Result &r = results[i];
+        fprintf(fp, "    {\"structure\": \"%s\", \"operation\": \"%s\", "
+                "\"capacity\": %d, \"ns_per_op\": {", r.structure,
+                r.operation, r.capacity);
+        for (int j = 0; j < NUM_OCCUPANCIES; j++) {
+            fprintf(fp, "%s\"%d\": ", j ? ", " : "", occupancies[j]);
+            if (r.ns[j] < 0)
+                fprintf(fp, "null");
+            else
+                fprintf(fp, "%.2f", r.ns[j]);
+        }
+        fprintf(fp, "}}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+}
+
+static const char *option_value(const char *arg, const char *name) {
+    size_t len = strlen(name);
+    if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0
+        || arg[2 + len] != '=')
+        return NULL;
+    return arg + 3 + len;
+}
+
+int main(int argc, char **argv) {
+    Micro_Options opt = {1000, 5};
+    const char *json_file = "apex_microbench.json";
+
+    for (int i = 1; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "batch")))
+            opt.batch = atoi(value);
+        else if ((value = option_value(argv[i], "repeat")))
+            opt.repeat = atoi(value);
+        else if ((value = option_value(argv[i], "json")))
+            json_file = value;
+        else {
+            fprintf(stderr, "usage: apex_microbench [--batch=N] [--repeat=N] "
+                            "[--json=FILE]\n");
+            return 1;
+        }
+    }
+    if (opt.batch < 1 || opt.repeat < 1)
+        return 1;
+
+    vector<Micro_Result> results;
+    shell_cpu = make_shell_cpu();
+    run_suite(&results, opt);
+    free_shell_cpu(shell_cpu);
+
+    FILE *fp = fopen(json_file, "w");
+    if (!fp) {
+        fprintf(stderr, "apex_microbench : cannot write %s\n", json_file);
+        return 1;
+    }
+    write_json(fp, opt, results);
+    fclose(fp);
+
+    printf("\n%-4s %-9s %8s", "", "ns/op", "capacity");
+    for (int j = 0; j < NUM_OCCUPANCIES; j++)
+        printf(" %8d", occupancies[j]);
+    printf("\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Micro_Result &r = results[i];
+        printf("%-4s %-9s ", r.structure, r.operation);
+        if (r.capacity)
+            printf("%8d", r.capacity);
+        else
+            printf("%8s", "-");
+        for (int j = 0; j < NUM_OCCUPANCIES; j++) {
+            if (r.ns[j] < 0)
+                printf(" %8s", "-");
+            else
+                printf(" %8.1f", r.ns[j]);
+        }
+        printf("\n");
+    }
+    printf("results in %s\n", json_file);
+    return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ *  program_image.cpp
+ *  Writes and loads pre-assembled binary program images, and keeps a
+ *  cache of images keyed by the hash of the .asm text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "program_image.h"
+
+/*
+ * Maps a whole file read-only. Returns NULL for a missing or empty file.
+ */
+static const char*
+map_file(const char* filename, size_t* length) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+	*length = st.st_size;
+	return (const char*) data;
+}
+
+/* 64-bit FNV-1a */
+static uint64_t
+hash_bytes(const char* data, size_t length) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= (unsigned char) data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static int
+is_image(const char* data, size_t length) {
+	return length >= sizeof(APEX_Image_Header)
+			&& memcmp(data, APEX_IMAGE_MAGIC, 8) == 0;
+}
+
+static int
+valid_registers(int rd, int rs1, int rs2) {
+	return rd >= 0 && rd < NUM_ARCH_REGISTERS && rs1 >= 0
+			&& rs1 < NUM_ARCH_REGISTERS && rs2 >= 0 && rs2 < NUM_ARCH_REGISTERS;
+}
+
+/*
+ * Writes code memory as an image. The image is written next to its final
+ * name and renamed into place, so concurrent runs sharing a cache never
+ * see a partial file. Returns 0 on success.
+ */
+static int
+write_program_image(const char* image_file, const APEX_Instruction* code,
+		int size, uint64_t source_hash) {
+	for (int i = 0; i < size; ++i) {
+		if (!valid_registers(code[i].rd, code[i].rs1, code[i].rs2)) {
+			fprintf(stderr,
+					"APEX_CPU : Instruction %d has a register out of range\n",
+					i);
+			return -1;
+		}
+	}
+
+	char tmp_file[4096];
+	snprintf(tmp_file, sizeof(tmp_file), "%s.%d.tmp", image_file, (int) getpid());
+	FILE* fp = fopen(tmp_file, "wb");
+	if (!fp) {
+		return -1;
+	}
+
+	APEX_Image_Header header;
+	memcpy(header.magic, APEX_IMAGE_MAGIC, 8);
+	header.count = size;
+	header.version = APEX_IMAGE_VERSION;
+	header.source_hash = source_hash;
+	int ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+	for (int i = 0; i < size && ok; ++i) {
+		APEX_Encoded_Instruction ins;
+		ins.op = code[i].op;
+		ins.rd = code[i].rd;
+		ins.rs1 = code[i].rs1;
+		ins.rs2 = code[i].rs2;
+		ins.imm = code[i].imm;
+		ok = fwrite(&ins, sizeof(ins), 1, fp) == 1;
+	}
+
+	if (fclose(fp) != 0 || !ok || rename(tmp_file, image_file) != 0) {
+		remove(tmp_file);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Expands a mapped image into code memory. Returns NULL if it is
+ * truncated, from another image version, or holds an unknown opcode or
+ * a register outside R0-R15.
+ */
+static APEX_Instruction*
+decode_image(const char* data, size_t length, int* size) {
+	const APEX_Image_Header* header = (const APEX_Image_Header*) data;
+	size_t count = header->count;
+	if (header->version != APEX_IMAGE_VERSION) {
+		return NULL;
+	}
+	if (!count || length != sizeof(*header)
+			+ count * sizeof(APEX_Encoded_Instruction)) {
+		return NULL;
+	}
+
+	APEX_Instruction* code_memory = (APEX_Instruction*) malloc(
+			sizeof(*code_memory) * count);
+	if (!code_memory) {
+		return NULL;
+	}
+
+	const APEX_Encoded_Instruction* ins =
+			(const APEX_Encoded_Instruction*) (data + sizeof(*header));
+	for (size_t i = 0; i < count; ++i) {
+		if (ins[i].op >= NUM_OPCODES
+				|| !valid_registers(ins[i].rd, ins[i].rs1, ins[i].rs2)) {
+			free(code_memory);
+			return NULL;
+		}
+		strcpy(code_memory[i].opcode, APEX_opcode_name(ins[i].op));
+		code_memory[i].op = ins[i].op;
+		code_memory[i].rd = ins[i].rd;
+		code_memory[i].rs1 = ins[i].rs1;
+		code_memory[i].rs2 = ins[i].rs2;
+		code_memory[i].imm = ins[i].imm;
+	}
+	*size = count;
+	return code_memory;
+}
+
+/*
+ * Assembler mode: converts a text program into an image.
+ * Returns 0 on success.
+ */
+int
+APEX_assemble(const char* asm_file, const char* image_file) {
+	size_t length;
+	const char* text = map_file(asm_file, &length);
+	if (!text) {
+		fprintf(stderr, "APEX_CPU : Cannot read %s\n", asm_file);
+		return -1;
+	}
+	uint64_t hash = hash_bytes(text, length);
+	munmap((void*) text, length);
+
+	int size = 0;
+	APEX_Instruction* code = create_code_memory(asm_file, &size);
+	if (!code) {
+		return -1;
+	}
+	int ret = write_program_image(image_file, code, size, hash);
+	if (ret != 0) {
+		fprintf(stderr, "APEX_CPU : Cannot write %s\n", image_file);
+	}
+	free(code);
+	return ret;
+}
+
+/*
+ * Loads a program given either as an image or as text. With an image
+ * cache directory configured, text programs are looked up there by the
+ * hash of their contents and only parsed on a miss, which also fills
+ * the cache.
+ */
+APEX_Instruction*
+load_program(const char* filename, int* size) {
+	size_t length;
+	const char* data = map_file(filename, &length);
+	if (!data) {
+		return NULL;
+	}
+
+	if (is_image(data, length)) {
+		APEX_Instruction* code_memory = decode_image(data, length, size);
+		munmap((void*) data, length);
+		if (!code_memory) {
+			fprintf(stderr, "APEX_CPU : %s is not a valid program image\n",
+					filename);
+		}
+		return code_memory;
+	}
+
+	uint64_t hash = hash_bytes(data, length);
+	munmap((void*) data, length);
+
+	if (!apex_config.image_cache_dir) {
+		return create_code_memory(filename, size);
+	}
+
+	char image_file[4096];
+	snprintf(image_file, sizeof(image_file), "%s/%016llx%s",
+			apex_config.image_cache_dir, (unsigned long long) hash,
+			APEX_IMAGE_SUFFIX);
+
+	size_t image_length;
+	const char* image = map_file(image_file, &image_length);
+	if (image) {
+		APEX_Instruction* code_memory = NULL;
+		if (is_image(image, image_length)
+				&& ((const APEX_Image_Header*) image)->source_hash == hash) {
+			code_memory = decode_image(image, image_length, size);
+		}
+		munmap((void*) image, image_length);
+		if (code_memory) {
+			return code_memory;
+		}
+	}
+
+	APEX_Instruction* code_memory = create_code_memory(filename, size);
+	if (code_memory) {
+		write_program_image(image_file, code_memory, *size, hash);
+	}
+	return code_memory;
+}
@@ -0,0 +1,41 @@
+/*
+ *  program_image.h
+ *  Pre-assembled binary program images. An image is a fixed header
+ *  followed by one fixed-width record per instruction, so it can be
+ *  mapped and copied into code memory without any text parsing.
+ */
+
+#ifndef _APEX_PROGRAM_IMAGE_H_
+#define _APEX_PROGRAM_IMAGE_H_
+
+#include <stdint.h>
+#include "cpu.h"
+
+#define APEX_IMAGE_MAGIC "APEXIMG1"
+/* Bumped whenever the parser or the encoding changes what an image holds,
+ * so images (and cache entries) written by an older build are rebuilt */
+#define APEX_IMAGE_VERSION 2
+#define APEX_IMAGE_SUFFIX ".apeximg"
+
+typedef struct APEX_Image_Header {
+	char magic[8];
+	uint32_t count;			// Number of instructions
+	uint32_t version;		// APEX_IMAGE_VERSION, 0 before versions existed
+	uint64_t source_hash;	// Hash of the .asm text the image was built from
+} APEX_Image_Header;
+
+typedef struct APEX_Encoded_Instruction {
+	uint8_t op;				// APEX_Opcode
+	uint8_t rd;
+	uint8_t rs1;
+	uint8_t rs2;
+	int32_t imm;
+} APEX_Encoded_Instruction;
+
+int
+APEX_assemble(const char* asm_file, const char* image_file);
+
+APEX_Instruction*
+load_program(const char* filename, int* size);
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ *  workload_gen.cpp
+ *  Generates synthetic APEX programs in the text format file_parser.cpp
+ *  reads, with controlled dependence, instruction mix, memory and
+ *  branch behaviour. The same options and seed always give the same
+ *  program.
+ *
+ *  Register use of the generated code:
+ *    R1-R6   working registers of the loop body
+ *    R7      branch condition, R8 call target
+ *    R10     call stack pointer, R11 link register
+ *    R12     stride, R13 data pointer, R14 constant 1, R15 loop counter
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define DATA_BASE 1000
+#define TABLE_BASE 50000
+#define STACK_BASE 60000
+#define MAX_RANDOM_ITERATIONS 10000
+
+enum {
+    PATTERN_PERIODIC, PATTERN_ALTERNATE, PATTERN_RANDOM
+};
+
+typedef struct Gen_Options {
+    int length;         // Body instructions per iteration, roughly
+    int iterations;
+    int chain;          // Length of each true dependence chain
+    double mul;         // Fraction of MUL
+    double mem;         // Fraction of LOAD/STORE
+    double store;       // Fraction of memory operations that are STOREs
+    int stride;         // Words the data pointer advances per iteration
+    double branch;      // Fraction of BZ/BNZ
+    double taken;       // Taken rate of those branches
+    int pattern;
+    int call_depth;     // Nesting of JAL calls made once per iteration
+    unsigned long seed;
+    const char *out;
+} Gen_Options;
+
+static unsigned long long rng_state;
+
+/* xorshift64*, fixed so programs are identical on every host */
+static unsigned long long next_random() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static double random_fraction() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int random_below(int n) {
+    return (int) (next_random() % n);
+}
+
+class Program {
+public:
+    vector<string> lines;
+
+    int pc() {
+        return 4000 + 4 * (int) lines.size();
+    }
+
+    void emit(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+void Program::emit(const char *fmt, ...) {
+    char buf[128];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    lines.push_back(buf);
+}
+
+/*
+ * Tracks the dependence chains of the body: every instruction inside a
+ * chain reads the previous one's result, a new chain starts from
+ * registers the last chain did not write.
+ */
+static int last_dest = 1;
+static int chain_pos = 0;
+
+static void pick_registers(const Gen_Options *opt, int *rd, int *rs1,
+                           int *rs2) {
+    if (chain_pos > 0) {
+        *rs1 = last_dest;
+    } else {
+        do {
+            *rs1 = 1 + random_below(6);
+        } while (*rs1 == last_dest);
+    }
+    *rs2 = 1 + random_below(6);
+    *rd = 1 + random_below(6);
+    last_dest = *rd;
+    chain_pos = (chain_pos + 1) % (opt->chain > 0 ? opt->chain : 1);
+}
+
+/*
+ * Emits the flag setup and the BZ/BNZ of one conditional branch, which
+ * skips the instruction after it when taken.
+ */
+static void emit_branch(const Gen_Options *opt, Program *prog) {
+    int bz = 1;
+    if (opt->pattern == PATTERN_ALTERNATE) {
+        // Zero on every other iteration
+        prog->emit("AND,R7,R15,R14");
+    } else if (opt->pattern == PATTERN_RANDOM) {
+        // Table holds 0 where the branch is taken
+        prog->emit("LOAD,R7,R15,#%d", TABLE_BASE);
+        prog->emit("ADDL,R7,R7,#0");
+    } else {
+        // Counter & (2^k - 1) is zero once every 2^k iterations
+        double rate = opt->taken >= 0.5 ? 1.0 - opt->taken : opt->taken;
+        int k = rate > 0 ? (int) floor(-log2(rate) + 0.5) : 30;
+        if (k > 30)
+            k = 30;
+        // BZ is taken on the zero iterations, BNZ on all the others
+        bz = opt->taken < 0.5;
+        prog->emit("MOVC,R7,#%d", (1 << k) - 1);
+        prog->emit("AND,R7,R15,R7");
+    }
+    prog->emit("%s,#8", bz ? "BZ" : "BNZ");
+    prog->emit("ADDL,R%d,R%d,#1", last_dest, last_dest);
+}
+
+static void emit_body_instruction(const Gen_Options *opt, Program *prog) {
+    static const char *const alu_ops[] = {"ADD", "SUB", "AND", "OR", "EX-OR"};
+    double r = random_fraction();
+    int rd, rs1, rs2;
+
+    if (r < opt->branch) {
+        emit_branch(opt, prog);
+        return;
+    }
+    r -= opt->branch;
+
+    if (r < opt->mem) {
+        int offset = random_below(opt->stride > 0 ? opt->stride : 1);
+        if (random_fraction() < opt->store) {
+            // Stores the head of the current chain
+            prog->emit("STORE,R%d,R13,#%d", last_dest, offset);
+        } else {
+            pick_registers(opt, &rd, &rs1, &rs2);
+            prog->emit("LOAD,R%d,R13,#%d", rd, offset);
+        }
+        return;
+    }
+    r -= opt->mem;
+
+    pick_registers(opt, &rd, &rs1, &rs2);
+    if (r < opt->mul)
+        prog->emit("MUL,R%d,R%d,R%d", rd, rs1, rs2);
+    else if (random_below(4) == 0)
+        prog->emit("ADDL,R%d,R%d,#%d", rd, rs1, 1 + random_below(16));
+    else
+        prog->emit("%s,R%d,R%d,R%d", alu_ops[random_below(5)], rd, rs1, rs2);
+}
+
+/*
+ * Function at depth d saves the link register on the stack, does a little
+ * work, calls depth d + 1 and returns through JUMP.
+ */
+static void emit_function(Program *prog, int depth, int call_depth,
+                          vector<int> *entry, vector<int> *fixups) {
+    (*entry)[depth] = prog->pc();
+    prog->emit("STORE,R11,R10,#0");
+    prog->emit("ADDL,R10,R10,#1");
+    prog->emit("ADDL,R%d,R%d,#1", 1 + depth % 6, 1 + depth % 6);
+    if (depth + 1 < call_depth) {
+        fixups->push_back((int) prog->lines.size());
+        prog->emit("MOVC,R8,#%d", depth + 1);
+        prog->emit("JAL,R11,R8,#0");
+    }
+    prog->emit("SUBL,R10,R10,#1");
+    prog->emit("LOAD,R11,R10,#0");
+    prog->emit("JUMP,R11,#0");
+}
+
+static void generate(const Gen_Options *opt, Program *prog) {
+    rng_state = opt->seed * 2654435761ULL + 88172645463325252ULL;
+
+    prog->emit("MOVC,R0,#0");
+    for (int i = 1; i <= 6; i++)
+        prog->emit("MOVC,R%d,#%d", i, i);
+    prog->emit("MOVC,R10,#%d", STACK_BASE);
+    prog->emit("MOVC,R12,#%d", opt->stride);
+    prog->emit("MOVC,R13,#%d", DATA_BASE);
+    prog->emit("MOVC,R14,#1");
+    prog->emit("MOVC,R15,#%d", opt->iterations);
+
+    if (opt->pattern == PATTERN_RANDOM) {
+        // Outcome of iteration n (counter value n) lives at TABLE_BASE + n
+        for (int n = 1; n <= opt->iterations; n++) {
+            if (random_fraction() < opt->taken)
+                continue;
+            prog->emit("STORE,R14,R0,#%d", TABLE_BASE + n);
+        }
+    }
+
+    int loop_start = prog->pc();
+    int body_start = (int) prog->lines.size();
+    while ((int) prog->lines.size() - body_start < opt->length)
+        emit_body_instruction(opt, prog);
+
+    vector<int> fixups;
+    if (opt->call_depth > 0) {
+        fixups.push_back((int) prog->lines.size());
+        prog->emit("MOVC,R8,#%d", 0);
+        prog->emit("JAL,R11,R8,#0");
+    }
+    prog->emit("ADD,R13,R13,R12");
+    prog->emit("SUBL,R15,R15,#1");
+    prog->emit("BNZ,#%d", loop_start - prog->pc());
+    prog->emit("HALT");
+
+    vector<int> entry(opt->call_depth > 0 ? opt->call_depth : 0);
+    for (int d = 0; d < opt->call_depth; d++)
+        emit_function(prog, d, opt->call_depth, &entry, &fixups);
+
+    // Call targets are only known once every function is placed
+    for (int i = 0; i < (int) fixups.size(); i++) {
+        int depth = atoi(prog->lines[fixups[i]].c_str() + strlen("MOVC,R8,#"));
+        char buf[64];
+        snprintf(buf, sizeof(buf), "MOVC,R8,#%d", entry[depth]);
+        prog->lines[fixups[i]] = buf;
+    }
+}
+
+static const char *option_value(const char *arg, const char *name) {
+    size_t len = strlen(name);
+    if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0
+        || arg[2 + len] != '=')
+        return NULL;
+    return arg + 3 + len;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: apex_workload_gen [--length=N] [--iterations=N] [--chain=N]\n"
+            "         [--mul=F] [--mem=F] [--store=F] [--stride=N]\n"
+            "         [--branch=F] [--taken=F] [--pattern=periodic|alternate|random]\n"
+            "         [--call-depth=N] [--seed=N] [--out=FILE]\n");
+}
+
+int main(int argc, char **argv) {
+    Gen_Options opt = {32, 100, 4, 0.1, 0.2, 0.3, 1, 0.1, 0.5,
+                       PATTERN_PERIODIC, 0, 1, NULL};
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value;
+        if ((value = option_value(arg, "length")))
+            opt.length = atoi(value);
+        else if ((value = option_value(arg, "iterations")))
+            opt.iterations = atoi(value);
+        else if ((value = option_value(arg, "chain")))
+            opt.chain = atoi(value);
+        else if ((value = option_value(arg, "mul")))
+            opt.mul = atof(value);
+        else if ((value = option_value(arg, "mem")))
+            opt.mem = atof(value);
+        else if ((value = option_value(arg, "store")))
+            opt.store = atof(value);
+        else if ((value = option_value(arg, "stride")))
+            opt.stride = atoi(value);
+        else if ((value = option_value(arg, "branch")))
+            opt.branch = atof(value);
+        else if ((value = option_value(arg, "taken")))
+            opt.taken = atof(value);
+        else if ((value = option_value(arg, "call-depth")))
+            opt.call_depth = atoi(value);
+        else if ((value = option_value(arg, "seed")))
+            opt.seed = strtoul(value, NULL, 10);
+        else if ((value = option_value(arg, "out")))
+            opt.out = value;
+        else if ((value = option_value(arg, "pattern"))) {
+            if (strcmp(value, "periodic") == 0)
+                opt.pattern = PATTERN_PERIODIC;
+            else if (strcmp(value, "alternate") == 0)
+                opt.pattern = PATTERN_ALTERNATE;
+            else if (strcmp(value, "random") == 0)
+                opt.pattern = PATTERN_RANDOM;
+            else {
+                usage();
+                return 1;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (opt.iterations < 1 || opt.length < 0 || opt.stride < 1
+        || opt.mul + opt.mem + opt.branch > 1.0
+        || (opt.pattern == PATTERN_RANDOM
+            && opt.iterations > MAX_RANDOM_ITERATIONS)) {
+        fprintf(stderr, "apex_workload_gen : invalid options\n");
+        return 1;
+    }
+
+    Program prog;
+    generate(&opt, &prog);
+
+    FILE *fp = opt.out ? fopen(opt.out, "w") : stdout;
+    if (!fp) {
+        fprintf(stderr, "apex_workload_gen : cannot write %s\n", opt.out);
+        return 1;
+    }
+    for (int i = 0; i < (int) prog.lines.size(); i++)
+        fprintf(fp, "%s\n", prog.lines[i].c_str());
+    if (opt.out)
+        fclose(fp);
+    return 0;
+}